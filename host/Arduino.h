@@ -0,0 +1,52 @@
+/* Host stand-in for the Arduino core: Serial, timing, GPIO interrupts and the ESP object */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+#include <ctype.h>
+
+#include "freertos.h"
+#include "pgmspace.h"
+
+class HardwareSerial {
+    public:
+        void begin(unsigned long baud) {}
+        int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+        size_t print(const char *s) { return fputs(s, stdout) < 0 ? 0 : strlen(s); }
+        size_t println(const char *s) { return print(s) + print("\n"); }
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+    public:
+        uint64_t getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+};
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+#define IRAM_ATTR
+#define INPUT   0x01
+#define FALLING 0x02
+#define digitalPinToInterrupt(pin) (pin)
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+/* Handlers are kept per pin and run by hostInterrupt(), on the caller's thread */
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+void hostInterrupt(uint8_t pin);
+
+void setup();
+void loop();
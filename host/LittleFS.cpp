@@ -0,0 +1,39 @@
+/* Host stand-in for the LittleFS filesystem */
+
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LittleFS.h"
+
+LittleFSFS LittleFS;
+
+static std::string hostPath(const char *path) { return std::string(HOST_FLASH_DIR) + path; }
+
+size_t File::size() {
+
+    struct stat st;
+    return file && fstat(fileno(file), &st) == 0 ? st.st_size : 0;
+}
+
+bool LittleFSFS::begin(bool formatOnFail) {
+
+    struct stat st;
+    return mkdir(HOST_FLASH_DIR, 0755) == 0 || (stat(HOST_FLASH_DIR, &st) == 0 && S_ISDIR(st.st_mode));
+}
+
+File LittleFSFS::open(const char *path, const char *mode) {
+
+    const char *hostMode = mode[0] == 'w' ? "wb" : mode[0] == 'a' ? "ab" : "rb";
+    return File(fopen(hostPath(path).c_str(), hostMode));
+}
+
+bool LittleFSFS::exists(const char *path) {
+
+    return access(hostPath(path).c_str(), F_OK) == 0;
+}
+
+bool LittleFSFS::remove(const char *path) {
+
+    return unlink(hostPath(path).c_str()) == 0;
+}
@@ -0,0 +1,39 @@
+/* Host stand-in for the LittleFS filesystem on the flash partition. Files are kept in
+ * HOST_FLASH_DIR on the host, so that what is written persists from one run to the next
+ * as it would across resets */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef HOST_FLASH_DIR
+#define HOST_FLASH_DIR "flash"
+#endif
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+class File {
+    public:
+        File(FILE *file = nullptr) : file(file) {}
+        operator bool() const { return file != nullptr; }
+        size_t write(const uint8_t *buf, size_t size) { return file ? fwrite(buf, 1, size, file) : 0; }
+        size_t read(uint8_t *buf, size_t size) { return file ? fread(buf, 1, size, file) : 0; }
+        bool seek(uint32_t pos) { return file && fseek(file, pos, SEEK_SET) == 0; }
+        size_t position() { return file ? ftell(file) : 0; }
+        size_t size();
+        void close() { if (file) { fclose(file); file = nullptr; } }
+    private:
+        FILE *file;
+};
+
+class LittleFSFS {
+    public:
+        bool begin(bool formatOnFail = false);
+        File open(const char *path, const char *mode = FILE_READ);
+        bool exists(const char *path);
+        bool remove(const char *path);
+};
+extern LittleFSFS LittleFS;
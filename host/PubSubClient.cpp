@@ -0,0 +1,87 @@
+/* Host stand-in for the PubSubClient MQTT client */
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "PubSubClient.h"
+
+struct Message {
+    std::string topic;
+    std::string payload;
+};
+
+static std::mutex queueMutex;
+static std::deque<Message> queue;
+
+/* One byte is written to the pipe per queued message, loop() drains it */
+static int *wakeupPipe() {
+
+    static int fds[2] = { -1, -1 };
+    static std::once_flag created;
+    std::call_once(created, []() {
+        if (pipe(fds)) { return; }
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    });
+    return fds;
+}
+
+int WiFiClient::fd() const {
+
+    return wakeupPipe()[0];
+}
+
+void mqttInject(const char *topic, const uint8_t *payload, size_t len) {
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back({topic, std::string((const char *)payload, len)});
+    }
+    uint8_t byte = 0;
+    if (write(wakeupPipe()[1], &byte, 1) < 0) { /* Pipe full, a wakeup is pending anyway */ }
+}
+
+bool PubSubClient::subscribe(const char *topic) {
+
+    snprintf(filter, sizeof(filter), "%s", topic);
+    return isConnected;
+}
+
+/* Only the trailing multi-level wildcard is supported */
+static bool topicMatches(const char *filter, const char *topic) {
+
+    size_t len = strlen(filter);
+    if (len >= 2 && !strcmp(filter + len - 2, "/#")) { return !strncmp(filter, topic, len - 1); }
+    return !strcmp(filter, topic);
+}
+
+bool PubSubClient::loop() {
+
+    if (!isConnected) { return false; }
+    uint8_t drain[64];
+    while (read(wakeupPipe()[0], drain, sizeof(drain)) > 0) {}
+    while (true) {
+        Message message;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (queue.empty()) { return true; }
+            message = queue.front();
+            queue.pop_front();
+        }
+
+        /* Publish packet: header byte, length byte, 2-byte topic length, topic, payload.
+         * The client moves the topic down a byte to terminate it in place, so the payload
+         * follows the terminator and may run to the very end of the buffer */
+        size_t topicLen = message.topic.size();
+        if (4 + topicLen + message.payload.size() > sizeof(buffer)) { continue; }
+        char *topic = (char *)buffer + 3;
+        memcpy(topic, message.topic.data(), topicLen);
+        topic[topicLen] = 0;
+        uint8_t *payload = buffer + 4 + topicLen;
+        memcpy(payload, message.payload.data(), message.payload.size());
+        if (callback && topicMatches(filter, topic)) { callback(topic, payload, message.payload.size()); }
+    }
+}
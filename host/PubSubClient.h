@@ -0,0 +1,38 @@
+/* Host stand-in for the PubSubClient MQTT client. There is no broker: messages are
+ * injected in-process with mqttInject() and delivered to the callback by loop(), from
+ * a packet buffer laid out as the real client's is */
+
+#pragma once
+
+#include <functional>
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 256
+#endif
+#ifndef MQTT_KEEPALIVE
+#define MQTT_KEEPALIVE 15
+#endif
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+class PubSubClient {
+    public:
+        PubSubClient(WiFiClient &client) {}
+        PubSubClient &setServer(const char *domain, uint16_t port) { return *this; }
+        PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE) { this->callback = callback; return *this; }
+        bool connect(const char *id, const char *user, const char *pass) { return isConnected = true; }
+        bool connected() { return isConnected; }
+        bool subscribe(const char *topic);
+        bool loop();
+    private:
+        MQTT_CALLBACK_SIGNATURE;
+        bool isConnected = false;
+        char filter[MQTT_MAX_PACKET_SIZE] = "";
+        uint8_t buffer[MQTT_MAX_PACKET_SIZE];
+};
+
+/* Queue a message as if published to the broker, safe from any thread */
+void mqttInject(const char *topic, const uint8_t *payload, size_t len);
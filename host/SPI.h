@@ -0,0 +1,12 @@
+/* Host stand-in for the SPI bus driver */
+
+#pragma once
+
+#define HSPI 2
+#define VSPI 3
+
+class SPIClass {
+    public:
+        SPIClass(int bus) {}
+        void begin(int sck, int miso, int mosi, int ss) {}
+};
@@ -0,0 +1,434 @@
+/* Host stand-in for the TFT_eSPI display driver */
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "TFT_eSPI.h"
+
+HostPanel hostPanel;
+
+/* Panel memory behind a pixel in a rotated coordinate space, as set by MADCTL */
+static uint16_t *panelPixel(uint8_t rotation, int32_t x, int32_t y) {
+
+    switch (rotation & 3) {
+        case 0: return &hostPanel.pixels[y][x];
+        case 1: return &hostPanel.pixels[x][y];
+        case 2: return &hostPanel.pixels[TFT_HEIGHT - 1 - y][TFT_WIDTH - 1 - x];
+        default: return &hostPanel.pixels[TFT_HEIGHT - 1 - x][TFT_WIDTH - 1 - y];
+    }
+}
+
+/* Column and row address set plus memory write commands for each window */
+#define WINDOW_BYTES 11
+
+uint16_t HostPanel::memoryRow(uint16_t line) {
+
+    if (line < scrollTop || line >= scrollTop + scrollLines || !scrollLines) { return line; }
+    return scrollTop + (line - scrollTop + scrollStart + scrollLines - scrollTop % scrollLines) % scrollLines;
+}
+
+bool HostPanel::writePPM(const char *path) {
+
+    FILE *file = fopen(path, "wb");
+    if (!file) { return false; }
+    bool landscape = rotation & 1;
+    int32_t w = landscape ? TFT_HEIGHT : TFT_WIDTH, h = landscape ? TFT_WIDTH : TFT_HEIGHT;
+    fprintf(file, "P6\n%d %d\n255\n", (int)w, (int)h);
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            size_t offset = panelPixel(rotation, x, y) - &pixels[0][0];
+            uint16_t c = pixels[memoryRow(offset / TFT_WIDTH)][offset % TFT_WIDTH];
+            uint8_t rgb[3] = { (uint8_t)((c >> 8 & 0xF8) | c >> 13), (uint8_t)((c >> 3 & 0xFC) | (c >> 9 & 3)),
+                               (uint8_t)((c << 3 & 0xF8) | (c >> 2 & 7)) };
+            fwrite(rgb, 1, 3, file);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+TFT_eSPI::TFT_eSPI(int16_t w, int16_t h) : _width(w), _height(h), _init_width(w), _init_height(h) {
+}
+
+void TFT_eSPI::setRotation(uint8_t r) {
+
+    rotation = r & 3;
+    hostPanel.rotation = rotation;
+    hostPanel.bytes += 2;
+    _width = rotation & 1 ? _init_height : _init_width;
+    _height = rotation & 1 ? _init_width : _init_height;
+}
+
+void TFT_eSPI::writecommand(uint8_t c) {
+
+    hostPanel.command = c;
+    hostPanel.paramCount = 0;
+    hostPanel.bytes++;
+}
+
+void TFT_eSPI::writedata(uint8_t d) {
+
+    HostPanel &p = hostPanel;
+    p.bytes++;
+    if (p.paramCount < sizeof(p.params)) { p.params[p.paramCount++] = d; }
+    if (p.command == 0x33 && p.paramCount == 6) {
+        p.scrollTop = p.params[0] << 8 | p.params[1];
+        p.scrollLines = p.params[2] << 8 | p.params[3];
+        if (p.scrollTop + p.scrollLines > TFT_HEIGHT) { p.scrollLines = TFT_HEIGHT - p.scrollTop; }
+    }
+    if (p.command == 0x37 && p.paramCount == 2) { p.scrollStart = p.params[0] << 8 | p.params[1]; }
+}
+
+void TFT_eSPI::drawPixel(int32_t x, int32_t y, uint32_t color) {
+
+    if (x < 0 || y < 0 || x >= _width || y >= _height) { return; }
+    *panelPixel(rotation, x, y) = color;
+    hostPanel.bytes += WINDOW_BYTES + 2;
+}
+
+void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > _width) { w = _width - x; }
+    if (y + h > _height) { h = _height - y; }
+    if (w <= 0 || h <= 0) { return; }
+    for (int32_t j = 0; j < h; j++) {
+        for (int32_t i = 0; i < w; i++) { *panelPixel(rotation, x + i, y + j) = color; }
+    }
+    hostPanel.bytes += WINDOW_BYTES + 2 * w * h;
+}
+
+/* Pixel blocks take as long on the simulated SPI bus as on the real one, and a transfer
+ * waits for the one before it. A blocking push sleeps until its transfer ends, while a
+ * DMA push returns at once and dmaWait() sleeps instead */
+#ifndef HOST_SPI_HZ
+#define HOST_SPI_HZ 40000000
+#endif
+
+static std::chrono::steady_clock::time_point busFreeTime;
+
+static void spiTransfer(uint32_t bytes, bool wait) {
+
+    auto start = std::max(std::chrono::steady_clock::now(), busFreeTime);
+    busFreeTime = start + std::chrono::nanoseconds(bytes * 8ull * 1000000000ull / HOST_SPI_HZ);
+    if (wait) { std::this_thread::sleep_until(busFreeTime); }
+}
+
+void TFT_eSPI::dmaWait() {
+
+    std::this_thread::sleep_until(busFreeTime);
+}
+
+bool TFT_eSPI::dmaBusy() {
+
+    return std::chrono::steady_clock::now() < busFreeTime;
+}
+
+void TFT_eSPI::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *image, uint16_t *buffer) {
+
+    dmaWait();
+    copyBlock(x, y, w, h, image, w);
+    spiTransfer(WINDOW_BYTES + 2 * w * h, false);
+}
+
+void TFT_eSPI::pushBlock(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data, int32_t stride) {
+
+    copyBlock(x, y, w, h, data, stride);
+    spiTransfer(WINDOW_BYTES + 2 * w * h, true);
+}
+
+void TFT_eSPI::copyBlock(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data, int32_t stride) {
+
+    for (int32_t j = 0; j < h; j++) {
+        for (int32_t i = 0; i < w; i++) {
+            if (x + i < 0 || y + j < 0 || x + i >= _width || y + j >= _height) { continue; }
+            uint16_t c = data[j * stride + i];
+            *panelPixel(rotation, x + i, y + j) = c >> 8 | c << 8;
+        }
+    }
+    hostPanel.bytes += WINDOW_BYTES + 2 * w * h;
+}
+
+uint16_t TFT_eSPI::alphaBlend(uint8_t alpha, uint16_t fgc, uint16_t bgc) {
+
+    uint32_t rxb = bgc & 0xF81F;
+    rxb += ((fgc & 0xF81F) - rxb) * (alpha >> 2) >> 6;
+    uint32_t xgx = bgc & 0x07E0;
+    xgx += ((fgc & 0x07E0) - xgx) * alpha >> 8;
+    return (rxb & 0xF81F) | (xgx & 0x07E0);
+}
+
+/* ----- Smooth fonts ----- */
+
+static uint32_t readInt32(const uint8_t *p) { return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+
+void TFT_eSPI::loadFont(const uint8_t array[]) {
+
+    if (fontLoaded) { unloadFont(); }
+    gFont.gArray = array;
+    gFont.gCount = readInt32(array);
+    gFont.ascent = readInt32(array + 16);
+    gFont.descent = readInt32(array + 20);
+    gFont.maxAscent = gFont.ascent;
+    gFont.maxDescent = gFont.descent;
+    gFont.yAdvance = gFont.ascent + gFont.descent;
+    gFont.spaceWidth = gFont.yAdvance / 4;
+
+    gUnicode = (uint16_t *)malloc(gFont.gCount * 2);
+    gHeight = (uint8_t *)malloc(gFont.gCount);
+    gWidth = (uint8_t *)malloc(gFont.gCount);
+    gxAdvance = (uint8_t *)malloc(gFont.gCount);
+    gdY = (int16_t *)malloc(gFont.gCount * 2);
+    gdX = (int8_t *)malloc(gFont.gCount);
+    gBitmap = (uint32_t *)malloc(gFont.gCount * 4);
+
+    const uint8_t *metrics = array + 24;
+    uint32_t bitmap = 24 + gFont.gCount * 28;
+    for (uint16_t i = 0; i < gFont.gCount; i++, metrics += 28) {
+        gUnicode[i] = readInt32(metrics);
+        gHeight[i] = readInt32(metrics + 4);
+        gWidth[i] = readInt32(metrics + 8);
+        gxAdvance[i] = readInt32(metrics + 12);
+        gdY[i] = readInt32(metrics + 16);
+        gdX[i] = readInt32(metrics + 20);
+        gBitmap[i] = bitmap;
+        bitmap += gWidth[i] * gHeight[i];
+        bool printable = (gUnicode[i] > 0x20 && gUnicode[i] < 0x7F) || gUnicode[i] > 0xA0;
+        if (printable && gdY[i] > gFont.maxAscent) { gFont.maxAscent = gdY[i]; }
+        if (printable && gHeight[i] - gdY[i] > gFont.maxDescent) { gFont.maxDescent = gHeight[i] - gdY[i]; }
+    }
+    gFont.yAdvance = gFont.maxAscent + gFont.maxDescent;
+    gFont.spaceWidth = (gFont.ascent + gFont.descent) * 2 / 7;
+    fontLoaded = true;
+}
+
+void TFT_eSPI::unloadFont() {
+
+    free(gUnicode); gUnicode = NULL;
+    free(gHeight); gHeight = NULL;
+    free(gWidth); gWidth = NULL;
+    free(gxAdvance); gxAdvance = NULL;
+    free(gdY); gdY = NULL;
+    free(gdX); gdX = NULL;
+    free(gBitmap); gBitmap = NULL;
+    fontLoaded = false;
+}
+
+bool TFT_eSPI::getUnicodeIndex(uint16_t unicode, uint16_t *index) {
+
+    for (uint16_t i = 0; i < gFont.gCount; i++) {
+        if (gUnicode[i] == unicode) { *index = i; return true; }
+    }
+    return false;
+}
+
+void TFT_eSPI::drawGlyph(uint16_t code) {
+
+    if (code == ' ') { cursor_x += gFont.spaceWidth; return; }
+    uint16_t index;
+    if (!getUnicodeIndex(code, &index)) {
+        fillRect(cursor_x + 1, cursor_y + gFont.maxAscent - gFont.ascent, gFont.spaceWidth, gFont.ascent, textcolor);
+        cursor_x += gFont.spaceWidth + 1;
+        return;
+    }
+    int32_t cx = cursor_x + gdX[index], cy = cursor_y + gFont.maxAscent - gdY[index];
+    const uint8_t *alpha = gFont.gArray + gBitmap[index];
+    for (int32_t y = 0; y < gHeight[index]; y++) {
+        for (int32_t x = 0; x < gWidth[index]; x++) {
+            uint8_t a = pgm_read_byte(alpha++);
+            if (a == 0xFF) { drawPixel(cx + x, cy + y, textcolor); }
+            else if (a) { drawPixel(cx + x, cy + y, alphaBlend(a, textcolor, textbgcolor)); }
+        }
+    }
+    cursor_x += gxAdvance[index];
+}
+
+/* Next code point of a UTF-8 string, Latin-1 range only as in the fonts */
+static uint16_t decodeUTF8(const char *&s) {
+
+    uint8_t c = *s++;
+    if ((c & 0xE0) == 0xC0 && (*s & 0xC0) == 0x80) { return (c & 0x1F) << 6 | (*s++ & 0x3F); }
+    return c;
+}
+
+int16_t TFT_eSPI::textWidth(const char *string) {
+
+    if (!fontLoaded) { return 6 * strlen(string); }
+    int16_t width = 0;
+    while (*string) {
+        uint16_t code = decodeUTF8(string);
+        uint16_t index;
+        if (code == ' ') { width += gFont.spaceWidth; }
+        else if (getUnicodeIndex(code, &index)) {
+            if (width == 0 && gdX[index] < 0) { width -= gdX[index]; }
+            width += *string ? gxAdvance[index] : gdX[index] + gWidth[index];
+        }
+        else { width += gFont.spaceWidth + 1; }
+    }
+    return width;
+}
+
+int16_t TFT_eSPI::drawString(const char *string, int32_t x, int32_t y) {
+
+    if (!fontLoaded) { return 0; }
+    int16_t width = textWidth(string), height = fontHeight();
+    switch (textdatum) {
+        case TC_DATUM: x -= width / 2; break;
+        case TR_DATUM: x -= width; break;
+        case ML_DATUM: y -= height / 2; break;
+        case MC_DATUM: x -= width / 2; y -= height / 2; break;
+        case MR_DATUM: x -= width; y -= height / 2; break;
+        case BL_DATUM: y -= height; break;
+        case BC_DATUM: x -= width / 2; y -= height; break;
+        case BR_DATUM: x -= width; y -= height; break;
+        case L_BASELINE: y -= gFont.maxAscent; break;
+        case C_BASELINE: x -= width / 2; y -= gFont.maxAscent; break;
+        case R_BASELINE: x -= width; y -= gFont.maxAscent; break;
+    }
+    setCursor(x, y);
+    while (*string) { drawGlyph(decodeUTF8(string)); }
+    return width;
+}
+
+/* Formats as TFT_eSPI does: rounded, no sign on values that round to zero */
+int16_t TFT_eSPI::drawFloat(float value, uint8_t dp, int32_t x, int32_t y) {
+
+    char str[24];
+    char *p = str;
+    if (dp > 7) { dp = 7; }
+    float rounding = 0.5;
+    for (uint8_t i = 0; i < dp; i++) { rounding /= 10.0; }
+    if (value < -rounding) { *p++ = '-'; value = -value; }
+    value += rounding;
+    if (value >= 2147483647) { return drawString("...", x, y); }
+    uint32_t whole = (uint32_t)value;
+    p += snprintf(p, str + sizeof(str) - p, "%u", (unsigned)whole);
+    if (dp) {
+        *p++ = '.';
+        value -= whole;
+        for (uint8_t i = 0; i < dp; i++) {
+            value *= 10.0;
+            uint8_t digit = (uint8_t)value;
+            *p++ = '0' + digit;
+            value -= digit;
+        }
+    }
+    *p = 0;
+    return drawString(str, x, y);
+}
+
+/* ----- Sprites ----- */
+
+void *TFT_eSprite::createSprite(int16_t w, int16_t h) {
+
+    deleteSprite();
+    _iwidth = _bpp == 4 ? (w + 1) & ~1 : _bpp == 1 ? (w + 7) & ~7 : w;
+    _img = calloc(_iwidth * h * _bpp / 8, 1);
+    if (!_img) { return nullptr; }
+    _width = _init_width = w;
+    _height = _init_height = h;
+    return _img;
+}
+
+void TFT_eSprite::deleteSprite() {
+
+    free(_img);
+    _img = nullptr;
+    _width = _height = 0;
+}
+
+void *TFT_eSprite::setColorDepth(int8_t b) {
+
+    _bpp = b == 4 || b == 1 ? b : 16;
+    if (!_img) { return nullptr; }
+    return createSprite(_width, _height);
+}
+
+void TFT_eSprite::createPalette(const uint16_t *palette, uint8_t colors) {
+
+    for (uint8_t i = 0; i < 16; i++) { _palette[i] = palette && i < colors ? palette[i] : 0; }
+}
+
+void TFT_eSprite::drawPixel(int32_t x, int32_t y, uint32_t color) {
+
+    if (x < 0 || y < 0 || x >= _width || y >= _height) { return; }
+    if (_bpp == 4) {
+        uint8_t *byte = (uint8_t *)_img + (y * _iwidth + x) / 2;
+        *byte = x & 1 ? (*byte & 0xF0) | (color & 0x0F) : (*byte & 0x0F) | (color & 0x0F) << 4;
+        return;
+    }
+    if (_bpp == 1) {
+        uint8_t *byte = (uint8_t *)_img + (y * _iwidth + x) / 8;
+        *byte = color ? *byte | 0x80 >> (x & 7) : *byte & ~(0x80 >> (x & 7));
+        return;
+    }
+    ((uint16_t *)_img)[y * _iwidth + x] = (uint16_t)(color >> 8 | color << 8);
+}
+
+void TFT_eSprite::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > _width) { w = _width - x; }
+    if (y + h > _height) { h = _height - y; }
+    if (_bpp != 16) {
+        for (int32_t j = 0; j < h; j++) {
+            for (int32_t i = 0; i < w; i++) { drawPixel(x + i, y + j, color); }
+        }
+        return;
+    }
+    uint16_t swapped = color >> 8 | color << 8;
+    for (int32_t j = 0; j < h; j++) {
+        for (int32_t i = 0; i < w; i++) { ((uint16_t *)_img)[(y + j) * _iwidth + x + i] = swapped; }
+    }
+}
+
+uint16_t TFT_eSprite::readPixelValue(int32_t x, int32_t y) {
+
+    if (x < 0 || y < 0 || x >= _width || y >= _height) { return 0; }
+    if (_bpp == 4) {
+        uint8_t byte = ((uint8_t *)_img)[(y * _iwidth + x) / 2];
+        return x & 1 ? byte & 0x0F : byte >> 4;
+    }
+    if (_bpp == 1) { return ((uint8_t *)_img)[(y * _iwidth + x) / 8] >> (7 - (x & 7)) & 1; }
+    uint16_t color = ((uint16_t *)_img)[y * _iwidth + x];
+    return color >> 8 | color << 8;
+}
+
+void TFT_eSprite::scroll(int16_t dx, int16_t dy) {
+
+    if (!_img) { return; }
+    std::vector<uint16_t> moved(_width * _height);
+    for (int32_t y = 0; y < _height; y++) {
+        for (int32_t x = 0; x < _width; x++) { moved[y * _width + x] = readPixelValue(x - dx, y - dy); }
+    }
+    for (int32_t y = 0; y < _height; y++) {
+        for (int32_t x = 0; x < _width; x++) { drawPixel(x, y, moved[y * _width + x]); }
+    }
+}
+
+/* A 4-bpp sprite is expanded through its palette, and a 1-bpp one to the bitmap colours,
+ * on the way to the panel, in one window as the library does. Like the library, it pushes
+ * each row of a 1-bpp sprite from its start, whatever sx is */
+bool TFT_eSprite::pushSprite(int32_t tx, int32_t ty, int32_t sx, int32_t sy, int32_t sw, int32_t sh) {
+
+    if (!_img || sx < 0 || sy < 0 || sw <= 0 || sh <= 0 || sx + sw > _width || sy + sh > _height) { return false; }
+    if (_bpp == 16) {
+        _tft->pushBlock(tx, ty, sw, sh, (uint16_t *)_img + sy * _iwidth + sx, _iwidth);
+        return true;
+    }
+    std::vector<uint16_t> expanded(sw * sh);
+    for (int32_t j = 0; j < sh; j++) {
+        const uint8_t *row = (const uint8_t *)_img + (sy + j) * _iwidth / 2;
+        for (int32_t i = 0; i < sw; i++) {
+            int32_t x = (_bpp == 1 ? 0 : sx) + i;
+            uint16_t color = _bpp == 1 ? readPixelValue(x, sy + j) ? _bitmap_fg : _bitmap_bg :
+                             _palette[x & 1 ? row[x / 2] & 0x0F : row[x / 2] >> 4];
+            expanded[j * sw + i] = color >> 8 | color << 8;
+        }
+    }
+    _tft->pushBlock(tx, ty, sw, sh, expanded.data(), sw);
+    return true;
+}
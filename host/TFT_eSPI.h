@@ -0,0 +1,173 @@
+/* Host stand-in for the TFT_eSPI display driver. The LCD is a RAM framebuffer laid out
+ * like the ILI9341's memory, smooth fonts are parsed and anti-aliased as the library
+ * does, and sprites keep their pixels byte-swapped in the same way */
+
+#pragma once
+
+#include "Arduino.h"
+#include "SPI.h"
+
+#ifndef TFT_WIDTH
+#define TFT_WIDTH   240
+#endif
+#ifndef TFT_HEIGHT
+#define TFT_HEIGHT  320
+#endif
+
+#define TFT_BLACK       0x0000
+#define TFT_NAVY        0x000F
+#define TFT_DARKGREEN   0x03E0
+#define TFT_MAROON      0x7800
+#define TFT_DARKGREY    0x7BEF
+#define TFT_BLUE        0x001F
+#define TFT_GREEN       0x07E0
+#define TFT_RED         0xF800
+#define TFT_YELLOW      0xFFE0
+#define TFT_WHITE       0xFFFF
+
+#define TL_DATUM    0
+#define TC_DATUM    1
+#define TR_DATUM    2
+#define ML_DATUM    3
+#define MC_DATUM    4
+#define MR_DATUM    5
+#define BL_DATUM    6
+#define BC_DATUM    7
+#define BR_DATUM    8
+#define L_BASELINE  9
+#define C_BASELINE  10
+#define R_BASELINE  11
+
+/* The panel's memory, TFT_HEIGHT rows of TFT_WIDTH pixels, and the traffic sent to it.
+ * Vertical scrolling, set up by the VSCRDEF and VSCRSADD commands, changes which memory
+ * row each line of the panel shows, not the memory */
+struct HostPanel {
+    uint16_t pixels[TFT_HEIGHT][TFT_WIDTH];
+    uint8_t rotation;
+    uint32_t bytes;             // Bytes sent over SPI, commands and pixel data
+    uint16_t scrollTop = 0;     // Fixed lines above the scrolling area
+    uint16_t scrollLines = TFT_HEIGHT;
+    uint16_t scrollStart = 0;   // Memory row shown on the first line of the scrolling area
+    uint8_t command;            // Last command, and the parameters written since
+    uint8_t params[6];
+    uint8_t paramCount;
+    uint16_t memoryRow(uint16_t line);
+    bool writePPM(const char *path);
+};
+extern HostPanel hostPanel;
+
+class TFT_eSPI {
+    public:
+        TFT_eSPI(int16_t w = TFT_WIDTH, int16_t h = TFT_HEIGHT);
+        virtual ~TFT_eSPI() { unloadFont(); }
+        void init() { setRotation(0); }
+        void setRotation(uint8_t r);
+        /* Controller commands and their parameters, of which only VSCRDEF and VSCRSADD
+         * have any effect */
+        void writecommand(uint8_t c);
+        void writedata(uint8_t d);
+        int16_t width() { return _width; }
+        int16_t height() { return _height; }
+
+        virtual void drawPixel(int32_t x, int32_t y, uint32_t color);
+        virtual void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+        void fillScreen(uint32_t color) { fillRect(0, 0, _width, _height, color); }
+        void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) { fillRect(x, y, 1, h, color); }
+        void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) { fillRect(x, y, w, 1, color); }
+        uint16_t alphaBlend(uint8_t alpha, uint16_t fgc, uint16_t bgc);
+
+        void setTextColor(uint16_t fg, uint16_t bg) { textcolor = fg; textbgcolor = bg; }
+        void setTextDatum(uint8_t datum) { textdatum = datum; }
+        void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+        int16_t textWidth(const char *string);
+        int16_t fontHeight() { return fontLoaded ? gFont.yAdvance : 8; }
+        int16_t drawString(const char *string, int32_t x, int32_t y);
+        int16_t drawFloat(float value, uint8_t dp, int32_t x, int32_t y);
+
+        /* Smooth fonts, as in TFT_eSPI's Smooth_font.h */
+        void loadFont(const uint8_t array[]);
+        void unloadFont();
+        bool getUnicodeIndex(uint16_t unicode, uint16_t *index);
+        virtual void drawGlyph(uint16_t code);
+        typedef struct {
+            const uint8_t *gArray;
+            uint16_t gCount;
+            uint16_t yAdvance;
+            uint16_t spaceWidth;
+            int16_t ascent;
+            int16_t descent;
+            uint16_t maxAscent;
+            uint16_t maxDescent;
+        } fontMetrics;
+        fontMetrics gFont = { nullptr, 0, 0, 0, 0, 0, 0, 0 };
+        uint16_t *gUnicode = NULL;
+        uint8_t *gHeight = NULL;
+        uint8_t *gWidth = NULL;
+        uint8_t *gxAdvance = NULL;
+        int16_t *gdY = NULL;
+        int8_t *gdX = NULL;
+        uint32_t *gBitmap = NULL;
+        bool fontLoaded = false;
+
+        /* Write a block of pixels, in sprite byte order, straight to the panel */
+        void pushBlock(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data, int32_t stride);
+
+        /* DMA pushes of pixels in sprite byte order, with the bus held between start and
+         * end of write. The image must not change until dmaWait() returns */
+        bool initDMA(bool ctrl_cs = false) { return true; }
+        void deInitDMA() {}
+        void startWrite() {}
+        void endWrite() {}
+        void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *image, uint16_t *buffer = nullptr);
+        void dmaWait();
+        bool dmaBusy();
+
+    protected:
+        void copyBlock(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data, int32_t stride);
+        int32_t _width;
+        int32_t _height;
+        int32_t _init_width;
+        int32_t _init_height;
+        uint8_t rotation = 0;
+        uint16_t textcolor = TFT_WHITE;
+        uint16_t textbgcolor = TFT_BLACK;
+        uint8_t textdatum = TL_DATUM;
+        int32_t cursor_x = 0;
+        int32_t cursor_y = 0;
+};
+
+class TFT_eSprite : public TFT_eSPI {
+    public:
+        TFT_eSprite(TFT_eSPI *tft) : TFT_eSPI(0, 0), _tft(tft) {}
+        ~TFT_eSprite() { deleteSprite(); }
+        void *createSprite(int16_t w, int16_t h);
+        void deleteSprite();
+        bool created() { return _img != nullptr; }
+        void *getPointer() { return _img; }
+        /* 16, 4 or 1 bits per pixel. A 4-bpp sprite holds palette indices, two pixels a
+         * byte with the left one in the high nibble, and a 1-bpp sprite eight pixels a
+         * byte with the left one in the top bit. Rows are padded to a whole byte */
+        void *setColorDepth(int8_t b);
+        int8_t getColorDepth() { return _bpp; }
+        void createPalette(const uint16_t *palette = nullptr, uint8_t colors = 16);
+        /* Colours a 1-bpp sprite's set and clear pixels are pushed as */
+        void setBitmapColor(uint16_t fg, uint16_t bg) { _bitmap_fg = fg; _bitmap_bg = fg == bg ? ~fg : bg; }
+        /* Colour for 16 bpp, palette index for 4 bpp, 0 or 1 for 1 bpp */
+        uint16_t readPixelValue(int32_t x, int32_t y);
+        /* Move the sprite's pixels by dx, dy, filling the area uncovered with black */
+        void scroll(int16_t dx, int16_t dy = 0);
+        void fillSprite(uint32_t color) { fillRect(0, 0, _width, _height, color); }
+        void drawPixel(int32_t x, int32_t y, uint32_t color) override;
+        void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) override;
+        void pushSprite(int32_t x, int32_t y) { pushSprite(x, y, 0, 0, _width, _height); }
+        /* Push the sw x sh area at sx, sy of the sprite to tx, ty on the panel */
+        bool pushSprite(int32_t tx, int32_t ty, int32_t sx, int32_t sy, int32_t sw, int32_t sh);
+    protected:
+        TFT_eSPI *_tft;
+        void *_img = nullptr;
+        int8_t _bpp = 16;
+        int32_t _iwidth = 0;        // Width of the buffer, even for 4 bpp, a multiple of 8 for 1 bpp
+        uint16_t _palette[16] = {};
+        uint16_t _bitmap_fg = TFT_WHITE;
+        uint16_t _bitmap_bg = TFT_BLACK;
+};
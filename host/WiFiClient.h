@@ -0,0 +1,10 @@
+/* Host stand-in for the WiFi TCP client. There is no socket: fd() is the read end of a
+ * pipe that mqttInject() writes to, so waiting on it wakes when a message is queued */
+
+#pragma once
+
+class WiFiClient {
+    public:
+        int available() { return 0; }
+        int fd() const;
+};
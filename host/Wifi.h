@@ -0,0 +1,25 @@
+/* Host stand-in for the ESP32 WiFi driver: always connected, via the host's network */
+
+#pragma once
+
+#include <string>
+
+#include "Arduino.h"
+
+#define WL_CONNECTED 3
+
+class IPAddress {
+    public:
+        std::string toString() const { return "127.0.0.1"; }
+};
+
+class WiFiClass {
+    public:
+        void begin(const char *ssid, const char *pass) {}
+        int status() { return WL_CONNECTED; }
+        IPAddress localIP() { return IPAddress(); }
+};
+extern WiFiClass WiFi;
+
+inline void configTime(long gmtOffset, int daylightOffset, const char *server1,
+    const char *server2 = nullptr, const char *server3 = nullptr) {}
@@ -0,0 +1,56 @@
+/* Host stand-in for the XPT2046 touch controller. Touches are simulated by host.cpp
+ * through hostTouch, on an ideal panel whose readings span the full 12-bit range in
+ * screen orientation, so it supplies its own calibration. Like the library, it only
+ * takes a new reading once HOST_TOUCH_MSEC have passed since the last one */
+
+#pragma once
+
+#include <atomic>
+
+#include "Arduino.h"
+#include "SPI.h"
+
+#define HOST_TOUCH_IRQ  36      // GPIO the controller's IRQ line is wired to
+#define HOST_TOUCH_MSEC 3       // The library's MSEC_THRESHOLD
+
+#define TOUCH_X_MIN     0
+#define TOUCH_X_MAX     4095
+#define TOUCH_Y_MIN     0
+#define TOUCH_Y_MAX     4095
+
+struct HostTouch {
+    std::atomic<bool> pressed{false};
+    std::atomic<int16_t> x{0};
+    std::atomic<int16_t> y{0};
+    void set(int sx, int sy) { x = (sx * 4095 + 318) / 319; y = (sy * 4095 + 238) / 239; pressed = true; }
+    void release() { pressed = false; }
+};
+extern HostTouch hostTouch;
+
+class TS_Point {
+    public:
+        TS_Point() {}
+        TS_Point(int16_t x, int16_t y, int16_t z) : x(x), y(y), z(z) {}
+        int16_t x = 0;
+        int16_t y = 0;
+        int16_t z = 0;
+};
+
+class XPT2046_Touchscreen {
+    public:
+        XPT2046_Touchscreen(uint8_t cs, uint8_t irq = 255) {}
+        bool begin(SPIClass &spi) { return true; }
+        void setRotation(uint8_t n) {}
+        bool tirqTouched() { return hostTouch.pressed; }
+        bool touched() { update(); return point.z; }
+        TS_Point getPoint() { update(); return point; }
+    private:
+        TS_Point point;
+        uint32_t msraw = 0x80000000;
+        void update() {
+            uint32_t now = millis();
+            if (now - msraw < HOST_TOUCH_MSEC) { return; }
+            msraw = now;
+            point = hostTouch.pressed ? TS_Point(hostTouch.x, hostTouch.y, 1000) : TS_Point();
+        }
+};
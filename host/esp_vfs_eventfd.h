@@ -0,0 +1,15 @@
+/* Host stand-in for the ESP-IDF event file descriptors, which are Linux eventfds here */
+
+#pragma once
+
+#include <sys/eventfd.h>
+
+#define EFD_SUPPORT_ISR 0
+
+typedef struct {
+    size_t max_fds;
+} esp_vfs_eventfd_config_t;
+
+#define ESP_VFS_EVENTD_CONFIG_DEFAULT() { 5 }
+
+inline int esp_vfs_eventfd_register(const esp_vfs_eventfd_config_t *config) { return 0; }
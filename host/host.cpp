@@ -0,0 +1,261 @@
+/* Host runtime: the Arduino core and FreeRTOS stand-ins, and main(). Runs setup(), then
+ * the Arduino loop on its own thread, and publishes each "<topic> <payload>" line read
+ * from stdin, or touches the screen for a "touch <x> <y> [<x2> <y2>] <ms>" line. At end
+ * of input it lets the tasks settle and, if a path is given, saves the screen as a PPM
+ * image. HOST_NO_MAIN leaves main() out, for the programs in ../test that have their own */
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Wifi.h"
+#include "PubSubClient.h"
+#include "TFT_eSPI.h"
+#include "XPT2046_Touchscreen.h"
+
+#ifndef HOST_SETTLE_MS
+#define HOST_SETTLE_MS 200
+#endif
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+
+int HardwareSerial::printf(const char *format, ...) {
+
+    va_list args;
+    va_start(args, format);
+    int len = vprintf(format, args);
+    va_end(args);
+    return len;
+}
+
+/* ----- Timing ----- */
+
+static const auto startTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms) {
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/* ----- GPIO interrupts ----- */
+
+static void (*interruptHandlers[40])();
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+
+    if (pin < 40) { interruptHandlers[pin] = handler; }
+}
+
+void hostInterrupt(uint8_t pin) {
+
+    if (pin < 40 && interruptHandlers[pin]) { interruptHandlers[pin](); }
+}
+
+/* ----- FreeRTOS tasks ----- */
+
+struct HostTask {
+    const char *name;
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+    clockid_t clock;                // CPU time of the thread running the task
+    uint32_t stackDepth = 8192;     // Default of the Arduino loop task
+};
+
+static thread_local HostTask *currentTask;
+static std::mutex tasksMutex;
+static std::vector<HostTask *> tasks;
+
+/* Make the calling thread a task */
+static HostTask *hostTaskStart(HostTask *task) {
+
+    pthread_getcpuclockid(pthread_self(), &task->clock);
+    std::lock_guard<std::mutex> lock(tasksMutex);
+    tasks.push_back(task);
+    return currentTask = task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth,
+    void *param, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+
+    HostTask *task = new HostTask;
+    task->name = name;
+    task->stackDepth = stackDepth;
+    if (handle) { *handle = task; }
+    std::thread([=]() { hostTaskStart(task); code(param); }).detach();
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+
+    if (!currentTask) { hostTaskStart(new HostTask)->name = "main"; }
+    return currentTask;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+
+    return (task ? task : xTaskGetCurrentTaskHandle())->stackDepth;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+
+    std::lock_guard<std::mutex> lock(tasksMutex);
+    return tasks.size();
+}
+
+/* Run time is CPU time in microseconds, and the total is time since start */
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *totalRunTime) {
+
+    std::lock_guard<std::mutex> lock(tasksMutex);
+    if (size < tasks.size()) { return 0; }
+    for (size_t i = 0; i < tasks.size(); i++) {
+        struct timespec cpu = {};
+        clock_gettime(tasks[i]->clock, &cpu);
+        status[i] = {};
+        status[i].xHandle = tasks[i];
+        status[i].pcTaskName = tasks[i]->name;
+        status[i].ulRunTimeCounter = cpu.tv_sec * 1000000u + cpu.tv_nsec / 1000;
+    }
+    if (totalRunTime) { *totalRunTime = micros(); }
+    return tasks.size();
+}
+
+void vTaskDelay(TickType_t ticks) {
+
+    delay(ticks * portTICK_PERIOD_MS);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+
+    HostTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    auto pending = [task]() { return task->notifications > 0; };
+    if (ticks == portMAX_DELAY) { task->notified.wait(lock, pending); }
+    else { task->notified.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pending); }
+    uint32_t count = task->notifications;
+    if (count) { task->notifications = clearOnExit ? 0 : count - 1; }
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+
+    xTaskNotifyGive(task);
+}
+
+/* ----- FreeRTOS queues ----- */
+
+struct HostQueue {
+    size_t length;
+    size_t itemSize;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+
+    HostQueue *queue = new HostQueue;
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto space = [queue]() { return queue->items.size() < queue->length; };
+    if (ticks == portMAX_DELAY) { queue->changed.wait(lock, space); }
+    else if (!queue->changed.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), space)) { return pdFAIL; }
+    queue->items.emplace_back((const uint8_t *)item, (const uint8_t *)item + queue->itemSize);
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto pending = [queue]() { return !queue->items.empty(); };
+    if (ticks == portMAX_DELAY) { queue->changed.wait(lock, pending); }
+    else if (!queue->changed.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pending)) { return pdFAIL; }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+/* ----- Touch ----- */
+
+HostTouch hostTouch;
+
+#ifndef HOST_NO_MAIN
+
+/* Press at x,y and, if given, move in a straight line to x2,y2, releasing after ms and
+ * then staying clear for long enough that the next touch is a separate one */
+static void touchGesture(const char *args) {
+
+    int x, y, x2, y2, ms;
+    int n = sscanf(args, "%d %d %d %d %d", &x, &y, &x2, &y2, &ms);
+    if (n == 3) { ms = x2; x2 = x; y2 = y; }
+    else if (n != 5) { return; }
+    for (int t = 0; t <= ms; t += 10) {
+        hostTouch.set(x + (x2 - x) * t / (ms ? ms : 1), y + (y2 - y) * t / (ms ? ms : 1));
+        if (!t) { hostInterrupt(HOST_TOUCH_IRQ); }
+        delay(10);
+    }
+    hostTouch.release();
+    delay(100);
+}
+
+/* ----- Main ----- */
+
+int main(int argc, char **argv) {
+
+    setup();
+    std::thread([]() {
+        hostTaskStart(new HostTask)->name = "loopTask";
+        while (true) { loop(); std::this_thread::yield(); }
+    }).detach();
+
+    char line[MQTT_MAX_PACKET_SIZE];
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = 0;
+        char *payload = strchr(line, ' ');
+        if (!payload) { continue; }
+        *payload++ = 0;
+        if (!strcmp(line, "touch")) { touchGesture(payload); }
+        else { mqttInject(line, (const uint8_t *)payload, strlen(payload)); }
+    }
+
+    delay(HOST_SETTLE_MS);
+    fflush(stdout);
+    if (argc > 1 && !hostPanel.writePPM(argv[1])) { fprintf(stderr, "cannot write %s\n", argv[1]); }
+    _exit(0);
+}
+
+#endif
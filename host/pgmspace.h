@@ -0,0 +1,8 @@
+/* Host stand-in for pgmspace.h: flash is ordinary memory */
+
+#pragma once
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
@@ -0,0 +1,8 @@
+/* Placeholder credentials for the host build, used when src/secrets.h does not exist */
+
+#define WIFI_SSID   "host"
+#define WIFI_PASS   ""
+#define MQTT_BROKER "localhost"
+#define MQTT_PORT   1883
+#define MQTT_USER   ""
+#define MQTT_PASS   ""
@@ -4,11 +4,24 @@
 #include <Wifi.h>                   // Driver for the ESP32 Wifi controller
 #include <PubSubClient.h>           // MQTT client library
 #include <WiFiClient.h>             // Wifi client library
+#include <LittleFS.h>               // Flash filesystem, for the history log
 #include <time.h>                   // Time library
-#include <vector>                   // Vector library
+#include <sys/select.h>             // Socket readiness
+#include <atomic>                   // Atomic library
 
 #include "secrets.h"                // Credentials
 
+/* Set to 1 to run the touch, display and MQTT handlers from one event loop on the Arduino
+ * loop task, rather than each on a task of its own */
+#ifndef EVENT_LOOP
+#define EVENT_LOOP 0
+#endif
+
+#if EVENT_LOOP
+#include <esp_vfs_eventfd.h>        // Event file descriptors, for waking the loop from ISRs
+#include <unistd.h>
+#endif
+
 /* Fonts from https://fonts.google.com/noto licensed under the Open Font License,
  * converted with TFT-eSPI/tools/Create_Smooth_Font Processing script */
 #include "NotoSansBold12.h"
@@ -16,74 +29,576 @@
 #include "NotoSansBold24.h"
 #include "NotoSansBold36.h"
 
-/* Record of data to be displayed */
+/* Fixed-capacity circular buffer, oldest item at the front. Its items are allocated from
+ * the heap when it is constructed, as there is more of that than of .bss */
+template <typename T, size_t N>
+class RingBuffer {
+    public:
+        RingBuffer() : items(new T[N]) {}
+        RingBuffer(const RingBuffer &) = delete;
+        ~RingBuffer() { delete[] items; }
+        size_t size() const { return count; }
+        bool full() const { return count == N; }
+        T &front() { return items[head]; }
+        T &back() { return items[(head + count - 1) % N]; }
+        T &operator[](size_t i) { return items[(head + i) % N]; }
+        void push_back(const T &item) {
+            if (full()) { pop_front(); }
+            items[(head + count++) % N] = item;
+        }
+        void pop_front() { head = (head + 1) % N; count--; }
+        void pop_back() { count--; }
+        void clear() { count = 0; }
+    private:
+        T *items;
+        size_t head = 0;
+        size_t count = 0;
+};
+
+/* Record of data to be displayed, kept as three tiers of history: raw samples for the
+ * last hour, 1-minute buckets for 24 hours and 15-minute buckets for 7 days. Samples are
+ * rolled up into the open minute bucket as they arrive, closed minutes into the open
+ * 15-minute bucket, and closed 15-minute buckets into the 7-day tier and the 24-hour
+ * high and low, so memory is bounded whatever the publish rate. The tiers take about
+ * 16 KB of heap per record */
+#ifndef DATA_RAW_SIZE
+#define DATA_RAW_SIZE   360         // Raw samples kept, oldest dropped early when full
+#endif
+#define DATA_RAW_WINDOW (60*60)     // Seconds of raw samples kept
+#define DATA_TICK       2           // Seconds per raw sample timestamp tick
+#define DATA_MINUTES    (60*24)     // 1-minute buckets kept, also the high/low window
+#define DATA_QUARTERS   (4*24*7)    // 15-minute buckets kept, also the week's high/low window
+#define DATA_COLUMN_MINUTES 5       // Minutes per graph column
+#define DATA_COLUMNS    (DATA_MINUTES / DATA_COLUMN_MINUTES)    // Graph columns kept, 24 hours
+#define DATA_COLUMN_EMPTY 0x7FFF8000    // Packed range of a column without samples, low above high
+
+/* Timestamps are stored in 16 bits, wrapping, and unwrapped relative to the newest one */
+static int32_t unwrap(uint16_t ticks, int32_t now) { return now - (uint16_t)(now - ticks); }
+
+/* Raw sample packed into 4 bytes, timestamp in ticks and value in fixed point */
 struct DataValue {
-    time_t timestamp;
+    uint16_t ticks;
+    int16_t value;
+};
+
+/* Range of the samples in one bucket, timestamp in bucket periods */
+struct DataBucket {
+    uint16_t ticks;
+    int16_t min;
+    int16_t max;
+};
+
+/* Bucket being filled */
+struct DataAccumulator {
+    int32_t period;
+    int16_t min;
+    int16_t max;
+    uint32_t count = 0;
+    void add(int32_t p, int16_t lo, int16_t hi, uint32_t n) {
+        if (!count) { period = p; min = lo; max = hi; }
+        if (lo < min) { min = lo; }
+        if (hi > max) { max = hi; }
+        count += n;
+    }
+    DataBucket bucket() { return {(uint16_t)period, min, max}; }
+};
+
+/* Minimum and maximum over a sliding window, as monotonic queues of the entries that
+ * can still become the extreme, so both are at the fronts */
+template <size_t N>
+class WindowExtremes {
+    public:
+        bool empty() { return !minimums.size(); }
+        int16_t min() { return minimums.front().value; }
+        int16_t max() { return maximums.front().value; }
+        void add(uint16_t ticks, int16_t lo, int16_t hi) {
+            while (minimums.size() && minimums.back().value >= lo) { minimums.pop_back(); }
+            minimums.push_back({ticks, lo});
+            while (maximums.size() && maximums.back().value <= hi) { maximums.pop_back(); }
+            maximums.push_back({ticks, hi});
+        }
+        void expire(int32_t cutoff, int32_t now) {
+            while (minimums.size() && unwrap(minimums.front().ticks, now) < cutoff) {
+                minimums.pop_front();
+            }
+            while (maximums.size() && unwrap(maximums.front().ticks, now) < cutoff) {
+                maximums.pop_front();
+            }
+        }
+        void clear() { minimums.clear(); maximums.clear(); }
+    private:
+        RingBuffer<DataValue, N> minimums;
+        RingBuffer<DataValue, N> maximums;
+};
+
+/* Display-relevant state of a record */
+struct DataSnapshot {
     float value;
+    float minimum;
+    float maximum;
+    uint32_t timestamp;         // Time of the newest sample, zero if none
+    uint32_t column;            // Graph column of the newest sample
 };
 
 class DataRecord {
     public:
-        void setValue(float value) {
+        DataRecord(float scale) : columns(new std::atomic<uint32_t>[DATA_COLUMNS]), scale(scale) {
+            for (uint32_t c = 0; c < DATA_COLUMNS; c++) {
+                columns[c].store(DATA_COLUMN_EMPTY, std::memory_order_relaxed);
+            }
+        }
+        DataRecord(const DataRecord &) = delete;
+        ~DataRecord() { delete[] columns; }
+        /* Heap taken by the tiers and columns, which are allocated on construction */
+        static constexpr size_t heapBytes() {
+            return DATA_RAW_SIZE * sizeof(DataValue) +
+                   (DATA_MINUTES + DATA_QUARTERS) * sizeof(DataBucket) +
+                   2 * (DATA_MINUTES / 15 + 1) * sizeof(DataValue) + DATA_COLUMNS * sizeof(uint32_t);
+        }
+        /* Add a sample taken at the given time, or now if zero or in the future. Returns
+         * whether the value, minimum, maximum or graph changed */
+        bool setValue(float value, time_t timestamp = 0) {
             time_t now = time(nullptr);
-            history.push_back({now, value});
-            time_t cutoff = now - 60*60*24;
-            while (history.size() && history.front().timestamp < cutoff) {
-                history.erase(history.begin());
+            if (timestamp && timestamp < now) { now = timestamp; }
+            if (raw.size()) {
+                if (now < latest) { now = latest; }
+                if (now - latest >= DATA_RAW_WINDOW) { raw.clear(); }
+                if (now - latest >= DATA_QUARTERS*15*60) { clear(); }
             }
+            latest = now;
+            int16_t fixed = encode(value);
+            int16_t previous = raw.size() ? raw.back().value : 0, low, high, newLow, newHigh;
+            dayRange(low, high);
+            raw.push_back({(uint16_t)(now / DATA_TICK), fixed});
+            rollup(now / 60, fixed);
+            bool graphed = addColumn(now / 60 / DATA_COLUMN_MINUTES, fixed);
+            expire(now);
+            dayRange(newLow, newHigh);
+            uint32_t column = latestColumn.load(std::memory_order_relaxed);
+            publish({decode(fixed), decode(newLow), decode(newHigh), (uint32_t)now, column});
+            return fixed != previous || newLow != low || newHigh != high || graphed || raw.size() == 1;
         };
-        float getValue() { return history.size() ? history.back().value : 0.0; }
-        float getMinimum() {
-            float min = getValue();
-            for (auto &v : history) if (v.value < min) { min = v.value; }
-            return min;
+        /* Copy of the state last published by setValue(), safe to take from another task.
+         * The sequence count is odd while a publish is in progress, so the reader retries
+         * if it was odd or moved on while copying; the writer never waits */
+        DataSnapshot getSnapshot() {
+            DataSnapshot snapshot;
+            uint32_t seq;
+            do {
+                seq = published.seq.load(std::memory_order_acquire);
+                snapshot.value = published.value.load(std::memory_order_acquire);
+                snapshot.minimum = published.minimum.load(std::memory_order_acquire);
+                snapshot.maximum = published.maximum.load(std::memory_order_acquire);
+                snapshot.timestamp = published.timestamp.load(std::memory_order_acquire);
+                snapshot.column = published.column.load(std::memory_order_acquire);
+            } while ((seq & 1) || seq != published.seq.load(std::memory_order_relaxed));
+            return snapshot;
+        }
+        /* Lowest and highest sample in a graph column, counted in DATA_COLUMN_MINUTES from
+         * the epoch. Safe to call from another task, as each column's range is updated as
+         * one word. False if empty, or not one of the DATA_COLUMNS up to the newest, as
+         * the slots of those after it still hold the columns from 24 hours before. Nor if
+         * a newer column has been started since, as its slot may be the one just read */
+        bool getColumn(uint32_t column, float &low, float &high) {
+            uint32_t newest = published.column.load(std::memory_order_acquire);
+            if (column > newest || newest - column >= DATA_COLUMNS) { return false; }
+            uint32_t packed = columns[column % DATA_COLUMNS].load(std::memory_order_acquire);
+            if (latestColumn.load(std::memory_order_relaxed) - column >= DATA_COLUMNS) { return false; }
+            int16_t lo = packed >> 16, hi = packed & 0xFFFF;
+            if (lo > hi) { return false; }
+            low = decode(lo);
+            high = decode(hi);
+            return true;
         }
-        float getMaximum() {
-            float max = getValue();
-            for (auto &v : history) if (v.value > max) { max = v.value; }
-            return max;
+        float getValue() { return raw.size() ? decode(raw.back().value) : 0.0; }
+        float getMinimum() { int16_t low, high; dayRange(low, high); return decode(low); }
+        float getMaximum() { int16_t low, high; dayRange(low, high); return decode(high); }
+        float getWeekMinimum() { int16_t low, high; weekRange(low, high); return decode(low); }
+        float getWeekMaximum() { int16_t low, high; weekRange(low, high); return decode(high); }
+        /* Values in the fixed point they are kept in, as the history log stores them */
+        int16_t encode(float value) {
+            float fixed = roundf(value / scale);
+            return fixed > INT16_MAX ? INT16_MAX : fixed < INT16_MIN ? INT16_MIN : (int16_t)fixed;
         }
+        float decode(int16_t value) { return value * scale; }
     private:
-        std::vector<DataValue> history;
+        RingBuffer<DataValue, DATA_RAW_SIZE> raw;
+        RingBuffer<DataBucket, DATA_MINUTES> minutes;
+        RingBuffer<DataBucket, DATA_QUARTERS> quarters;
+        DataAccumulator thisMinute;
+        DataAccumulator thisQuarter;
+        WindowExtremes<DATA_MINUTES / 15 + 1> dayExtremes;    // Closed quarters wholly in the last day
+        std::atomic<uint32_t> *columns;     // Low and high of each column, in the top and bottom halves
+        std::atomic<uint32_t> latestColumn{0};  // Column of the newest sample, set before emptying slots
+        time_t latest = 0;          // Time of the newest sample
+        float scale;                // Value of one fixed point step
+        struct {
+            std::atomic<uint32_t> seq{0};
+            std::atomic<float> value{0};
+            std::atomic<float> minimum{0};
+            std::atomic<float> maximum{0};
+            std::atomic<uint32_t> timestamp{0};
+            std::atomic<uint32_t> column{0};
+        } published;
+        void publish(const DataSnapshot &snapshot) {
+            uint32_t seq = published.seq.load(std::memory_order_relaxed);
+            published.seq.store(seq + 1, std::memory_order_relaxed);
+            published.value.store(snapshot.value, std::memory_order_release);
+            published.minimum.store(snapshot.minimum, std::memory_order_release);
+            published.maximum.store(snapshot.maximum, std::memory_order_release);
+            published.timestamp.store(snapshot.timestamp, std::memory_order_release);
+            published.column.store(snapshot.column, std::memory_order_release);
+            published.seq.store(seq + 2, std::memory_order_release);
+        }
+        void rollup(int32_t minute, int16_t value) {
+            if (thisMinute.count && thisMinute.period != minute) {
+                int32_t quarter = thisMinute.period / 15;
+                if (thisQuarter.count && thisQuarter.period != quarter) { closeQuarter(); }
+                minutes.push_back(thisMinute.bucket());
+                thisQuarter.add(quarter, thisMinute.min, thisMinute.max, thisMinute.count);
+                thisMinute.count = 0;
+            }
+            if (thisQuarter.count && thisQuarter.period != minute / 15) { closeQuarter(); }
+            thisMinute.add(minute, value, value, 1);
+        }
+        /* Columns are kept up to date as samples arrive, so that a graph never has to scan
+         * the history. Those passed over without samples are emptied. Returns whether the
+         * newest column moved on or its range changed */
+        bool addColumn(uint32_t column, int16_t value) {
+            uint32_t latest = latestColumn.load(std::memory_order_relaxed);
+            bool moved = column != latest;
+            if (moved) {
+                /* Stored first, and the slots released after it, so that a reader that sees
+                 * a slot emptied or reused also sees the column that did it */
+                latestColumn.store(column, std::memory_order_relaxed);
+                uint32_t first = column - latest < DATA_COLUMNS ? latest + 1 : column - DATA_COLUMNS + 1;
+                for (uint32_t c = first; c != column + 1; c++) {
+                    columns[c % DATA_COLUMNS].store(DATA_COLUMN_EMPTY, std::memory_order_release);
+                }
+            }
+            std::atomic<uint32_t> &range = columns[column % DATA_COLUMNS];
+            uint32_t packed = range.load(std::memory_order_relaxed);
+            int16_t lo = packed >> 16, hi = packed & 0xFFFF;
+            if (value >= lo && value <= hi) { return moved; }
+            if (value < lo) { lo = value; }
+            if (value > hi) { hi = value; }
+            range.store((uint32_t)(uint16_t)lo << 16 | (uint16_t)hi, std::memory_order_release);
+            return true;
+        }
+        void closeQuarter() {
+            DataBucket bucket = thisQuarter.bucket();
+            quarters.push_back(bucket);
+            dayExtremes.add(bucket.ticks, bucket.min, bucket.max);
+            thisQuarter.count = 0;
+        }
+        void expire(time_t now) {
+            int32_t ticks = now / DATA_TICK;
+            int32_t minute = now / 60;
+            int32_t cutoff = minute - DATA_MINUTES;
+            while (unwrap(raw.front().ticks, ticks) < ticks - DATA_RAW_WINDOW / DATA_TICK) {
+                raw.pop_front();
+            }
+            while (minutes.size() && unwrap(minutes.front().ticks, minute) < cutoff) {
+                minutes.pop_front();
+            }
+            dayExtremes.expire((cutoff + 14) / 15, minute / 15);
+            cutoff = minute / 15 - DATA_QUARTERS;
+            while (quarters.size() && unwrap(quarters.front().ticks, minute / 15) < cutoff) {
+                quarters.pop_front();
+            }
+        }
+        void clear() {
+            raw.clear();
+            minutes.clear();
+            quarters.clear();
+            dayExtremes.clear();
+            thisMinute.count = 0;
+            thisQuarter.count = 0;
+        }
+        /* The last 24 hours are the open buckets, the closed quarters wholly in the window,
+         * and the minute buckets of the partial quarter at its start */
+        void dayRange(int16_t &low, int16_t &high) {
+            low = high = 0;
+            if (!raw.size()) { return; }
+            int32_t minute = latest / 60;
+            int32_t edge = (minute - DATA_MINUTES + 14) / 15 * 15;
+            openRange(low, high);
+            if (!dayExtremes.empty()) {
+                if (dayExtremes.min() < low) { low = dayExtremes.min(); }
+                if (dayExtremes.max() > high) { high = dayExtremes.max(); }
+            }
+            for (size_t i = 0; i < minutes.size() && unwrap(minutes[i].ticks, minute) < edge; i++) {
+                if (minutes[i].min < low) { low = minutes[i].min; }
+                if (minutes[i].max > high) { high = minutes[i].max; }
+            }
+        }
+        void weekRange(int16_t &low, int16_t &high) {
+            low = high = 0;
+            if (!raw.size()) { return; }
+            openRange(low, high);
+            for (size_t i = 0; i < quarters.size(); i++) {
+                if (quarters[i].min < low) { low = quarters[i].min; }
+                if (quarters[i].max > high) { high = quarters[i].max; }
+            }
+        }
+        void openRange(int16_t &low, int16_t &high) {
+            low = thisMinute.min;
+            high = thisMinute.max;
+            if (thisQuarter.count) {
+                if (thisQuarter.min < low) { low = thisQuarter.min; }
+                if (thisQuarter.max > high) { high = thisQuarter.max; }
+            }
+        }
 };
 
 class DataSet {
     public:
-        DataRecord temperature;
-        DataRecord humidity;
-        DataRecord pressure;
+        DataRecord temperature{0.01};   // 0.01 °C
+        DataRecord humidity{0.1};       // 0.1 %RH
+        DataRecord pressure{0.1};       // 0.1 hPa
 };
 
 class Data {
     public:
         DataSet indoor;
         DataSet outdoor;
-        bool dirty = false;
 } data;
 
+/* Smooth fonts used by the display, see FontCache */
+enum Font { FONT_12, FONT_18, FONT_24, FONT_36, FONT_COUNT };
+
+/* Tasks, other than the Arduino loop task, in the order of taskConfigs */
+enum TaskId { TASK_TOUCH, TASK_DISPLAY, TASK_MQTT, TASK_COUNT };
+
+/* Touch gestures, passed from the touch task to the display */
+enum TouchGesture {
+    TOUCH_TAP, TOUCH_LONG_PRESS, TOUCH_SWIPE_LEFT, TOUCH_SWIPE_RIGHT, TOUCH_SWIPE_UP, TOUCH_SWIPE_DOWN
+};
+
+struct TouchEvent {
+    TouchGesture gesture;
+    int16_t x;                  // Screen coordinates of where the touch started
+    int16_t y;
+};
+
+/* The numbers a value widget shows, as formatted for drawing */
+struct WidgetText {
+    char value[16];
+    char maximum[16];
+    char minimum[16];
+};
+
 /* Function prototypes */
 void touchInit();
 void touchTask(void *param);
+void touchBegin();
+void touchStart();
+bool touchStep();
+bool touchPoint(XPT2046_Touchscreen *ts, int16_t *x, int16_t *y);
+void touchEmit(TouchGesture gesture, int16_t x, int16_t y);
 void dispInit();
 void dispTask(void *param);
-void dispValueWidget(TFT_eSprite *spr, const char *label, DataRecord *data, uint8_t dp);
+void dispBegin();
+void dispHome();
+void dispUpdate();
+uint32_t dispWidgets(uint32_t *bytes);
+void dispTouch(const TouchEvent &event);
+void dispNotify();
+void formatFloat(char *str, size_t size, float value, uint8_t dp);
+void dispValueWidget(TFT_eSprite *spr, const char *label, const WidgetText &text);
+size_t dispSpriteBytes(TFT_eSprite *spr);
+void dispPushSpan(TFT_eSprite *spr, int32_t x, int32_t y, int32_t sx, int32_t sy, int32_t sw,
+                  int32_t sh);
+uint32_t dispPushDiff(TFT_eSprite *spr, int32_t x, int32_t y, const uint8_t *shadow, uint32_t *bytes);
+void dispNumber(TFT_eSprite *spr, Font font, uint16_t fg, const char *str, int32_t x, int32_t y);
+void dispString(TFT_eSprite *spr, uint16_t fg, const char *str, int32_t x, int32_t y);
+uint32_t dispGraph(struct Widget *w, const DataSnapshot &snapshot, uint32_t *bytes);
+void dispGraphPoint(TFT_eSprite *graph, DataRecord *data, uint32_t point, int32_t x, float low,
+                    float high);
+void dispChartOpen(struct Widget *w);
+uint32_t dispChart(uint32_t *bytes);
+uint32_t dispChartColumn(DataRecord *data, uint32_t column, uint32_t *bytes);
+int32_t dispChartRow(float value);
+uint32_t dispChartStrip(const WidgetText &text, uint32_t *bytes);
+void dispScrollArea(uint16_t top, uint16_t lines);
+void dispScrollStart(uint16_t line);
 void wifiInit();
 void mqttInit();
 void mqttTask(void *param);
 void mqttHandleMessage(char* topic, uint8_t* payload, unsigned int len);
+const struct TopicRoute *mqttTopicRoute(const char *topic);
+const uint8_t *parseNumber(const uint8_t *p, const uint8_t *end, double *value);
+bool mqttParseValue(const uint8_t *payload, unsigned int len, float *value);
+void mqttHandleState(DataSet *set, const uint8_t *payload, unsigned int len);
+void mqttPoll();
+uint32_t mqttTimeout(int *fd);
+void mqttWait();
+void logInit();
+void logReplay();
+bool logReadBlock(File &file, struct LogHeader *header, uint32_t start);
+void logPath(char *path, size_t size, uint8_t file);
+void logSample(DataRecord *record);
+void logMinute(uint8_t id);
+void logPoll();
+void logFlush();
+uint32_t logCrc(uint32_t crc, const void *data, size_t len);
+void eventInit();
+void eventWake();
+void eventStep();
+BaseType_t taskCreate(TaskFunction_t code, TaskId id, TaskHandle_t *handle);
+void schedReport();
+
+/* ----- Scheduling ----- */
+
+/* Where the tasks run, selected at build time with SCHED_PROFILE */
+#define SCHED_ALL_ON_1  0       // All on core 1, leaving core 0 to the WiFi stack
+#define SCHED_SPLIT     1       // MQTT on core 0 beside the WiFi stack, touch and display on core 1
+#define SCHED_FLOATING  2       // No affinity, the scheduler balances the cores
+
+#ifndef SCHED_PROFILE
+#define SCHED_PROFILE SCHED_ALL_ON_1
+#endif
+
+struct TaskConfig {
+    const char *name;
+    BaseType_t core;            // tskNO_AFFINITY to run on either
+    UBaseType_t priority;
+};
+
+constexpr TaskConfig taskConfigs[][TASK_COUNT] = {
+    /* SCHED_ALL_ON_1 */ { { "Touch", 1, 2 }, { "Display", 1, 2 }, { "Subscriber", 1, 2 } },
+    /* SCHED_SPLIT */    { { "Touch", 1, 3 }, { "Display", 1, 2 }, { "Subscriber", 0, 2 } },
+    /* SCHED_FLOATING */ { { "Touch", tskNO_AFFINITY, 3 }, { "Display", tskNO_AFFINITY, 2 },
+                           { "Subscriber", tskNO_AFFINITY, 2 } },
+};
+static_assert(SCHED_PROFILE < sizeof(taskConfigs) / sizeof(taskConfigs[0]), "unknown SCHED_PROFILE");
+
+/* Stack sizes in bytes. These are estimates, not measured peaks: on a device, tune each
+ * to the peak schedReport() prints after a while of use, plus SCHED_STACK_MARGIN, rounded
+ * up. The display needs much for smooth font rendering, and so does the MQTT task, which
+ * besides the client's calls writes and replays the history log through LittleFS */
+#ifndef TOUCH_STACK
+#define TOUCH_STACK     3072
+#endif
+#ifndef DISP_STACK
+#define DISP_STACK      5120
+#endif
+#ifndef MQTT_STACK
+#define MQTT_STACK      6144
+#endif
+#define SCHED_STACK_MARGIN 512
+
+constexpr uint32_t taskStacks[TASK_COUNT] = { TOUCH_STACK, DISP_STACK, MQTT_STACK };
+
+TaskHandle_t taskHandles[TASK_COUNT];
+
+BaseType_t taskCreate(TaskFunction_t code, TaskId id, TaskHandle_t *handle) {
+
+    const TaskConfig &config = taskConfigs[SCHED_PROFILE][id];
+    BaseType_t result = xTaskCreatePinnedToCore(code, config.name, taskStacks[id], nullptr,
+                                                config.priority, handle, config.core);
+    taskHandles[id] = *handle;
+    return result;
+}
+
+/* Time spent in each of our handlers, timed with micros() so that it is known whatever
+ * FreeRTOS was configured with. A SchedBusy at the top of a handler counts the time until
+ * it returns, including any waits within it, such as between touch readings */
+std::atomic<uint32_t> schedBusy[TASK_COUNT];     // Microseconds since the last report
+
+struct SchedBusy {
+    TaskId id;
+    uint32_t start = micros();
+    ~SchedBusy() { schedBusy[id].fetch_add(micros() - start, std::memory_order_relaxed); }
+};
+
+/* The stack each of our tasks has used at its peak, the share of the time each of our
+ * handlers has been busy since the last report, and the share of a core every task has
+ * used. The last needs the run time counters, which are only kept if FreeRTOS is
+ * configured with CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, as the stock Arduino core's
+ * is not (see platformio.ini) */
+#ifndef SCHED_STATS_INTERVAL
+#define SCHED_STATS_INTERVAL 60000  // Milliseconds between reports
+#endif
+#define SCHED_MAX_TASKS 24
+
+uint32_t schedReportTime;           // millis() at the last report
+
+void schedReport() {
+
+    uint32_t interval = millis() - schedReportTime;
+    schedReportTime += interval;
+    for (size_t id = 0; id < TASK_COUNT; id++) {
+        if (!taskHandles[id]) { continue; }
+        uint32_t unused = uxTaskGetStackHighWaterMark(taskHandles[id]);
+        Serial.printf("[Sched] %-16s stack %u of %u bytes used at peak%s\n",
+                      taskConfigs[SCHED_PROFILE][id].name, taskStacks[id] - unused, taskStacks[id],
+                      unused < SCHED_STACK_MARGIN ? ", under margin" : "");
+    }
+    Serial.printf("[Sched] %-16s stack %u bytes unused at peak\n", "loopTask",
+                  uxTaskGetStackHighWaterMark(nullptr));
+    for (size_t id = 0; id < TASK_COUNT && interval; id++) {
+        uint32_t busy = schedBusy[id].exchange(0, std::memory_order_relaxed);
+        Serial.printf("[Sched] %-16s handler busy %5.1f%%\n", taskConfigs[SCHED_PROFILE][id].name,
+                      busy / 10.0f / interval);
+    }
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    static TaskStatus_t status[SCHED_MAX_TASKS];
+    static struct { TaskHandle_t handle; uint32_t runTime; } previous[SCHED_MAX_TASKS];
+    static uint32_t previousTotal;
+    uint32_t total;
+
+    UBaseType_t count = uxTaskGetSystemState(status, SCHED_MAX_TASKS, &total);
+    uint32_t elapsed = total - previousTotal;
+    for (UBaseType_t i = 0; i < count && previousTotal && elapsed; i++) {
+        uint32_t runTime = status[i].ulRunTimeCounter;
+        for (auto &p : previous) {
+            if (p.handle == status[i].xHandle) { runTime -= p.runTime; break; }
+        }
+        Serial.printf("[Sched] %-16s %5.1f%%\n", status[i].pcTaskName, runTime * 100.0f / elapsed);
+    }
+    for (UBaseType_t i = 0; i < SCHED_MAX_TASKS; i++) {
+        previous[i].handle = i < count ? status[i].xHandle : nullptr;
+        previous[i].runTime = i < count ? status[i].ulRunTimeCounter : 0;
+    }
+    previousTotal = total;
+#else
+    static bool warned = false;
+    if (!warned) {
+        Serial.println("[Sched] run time stats are not enabled in FreeRTOS, so only handlers are timed");
+    }
+    warned = true;
+#endif
+}
 
 /* Main functionality */
 
 void setup() {
 
     Serial.begin(115200);
+    Serial.printf("[Data] %u bytes per record, and %u of heap\n", (unsigned)sizeof(DataRecord),
+                  (unsigned)DataRecord::heapBytes());
+#if EVENT_LOOP
+    eventInit();
+#endif
     touchInit();
     dispInit();
     wifiInit();
+    logInit();
     mqttInit();
 }
 
 void loop() {
+
+#if EVENT_LOOP
+    eventStep();
+    if (millis() - schedReportTime >= SCHED_STATS_INTERVAL) { schedReport(); }
+#else
+    /* Everything happens in the tasks, so report on them rather than spin here */
+    schedReport();
+    vTaskDelay(pdMS_TO_TICKS(SCHED_STATS_INTERVAL));
+#endif
 }
 
 /* ----- WiFi ----- */
@@ -100,58 +615,659 @@ void wifiInit() {
 /* ----- MQTT Task ----- */
 
 #define MQTT_RETRY_INTERVAL 10
+#ifndef MQTT_STATS_INTERVAL
+#define MQTT_STATS_INTERVAL 60000   // Milliseconds between wakeup reports
+#endif
+
+struct MqttStats {
+    uint32_t wakeups;           // Times the task woke up, since the last report
+    uint32_t messages;          // Messages handled, since the last report
+    uint32_t reportTime;        // millis() at the last report
+} mqttStats;
+
+/* Topics subscribed to and the records they update, one entry per topic. A topic with
+ * no record carries a JSON object updating any of the records of its set */
+struct TopicRoute {
+    const char *topic;
+    DataSet Data::*set;
+    DataRecord DataSet::*record;
+};
+
+constexpr TopicRoute topicRoutes[] = {
+    { "enviro/indoor", &Data::indoor, nullptr },
+    { "enviro/outdoor", &Data::outdoor, nullptr },
+    { "enviro/indoor/temperature", &Data::indoor, &DataSet::temperature },
+    { "enviro/indoor/humidity", &Data::indoor, &DataSet::humidity },
+    { "enviro/indoor/pressure", &Data::indoor, &DataSet::pressure },
+    { "enviro/outdoor/temperature", &Data::outdoor, &DataSet::temperature },
+    { "enviro/outdoor/humidity", &Data::outdoor, &DataSet::humidity },
+    { "enviro/outdoor/pressure", &Data::outdoor, &DataSet::pressure },
+};
+
+/* Perfect hash of the topics, generated at compile time: the first seed for which the
+ * FNV-1a hashes of all topics land in different slots */
+#define TOPIC_SLOTS 16
+
+constexpr uint32_t topicHash(const char *topic, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    while (*topic) { hash = (hash ^ (uint8_t)*topic++) * 16777619u; }
+    return hash;
+}
+
+struct TopicTable {
+    uint32_t seed;
+    int8_t slots[TOPIC_SLOTS];      // Index into topicRoutes, -1 if empty
+};
+
+constexpr TopicTable topicTableBuild() {
+    for (uint32_t seed = 0; ; seed++) {
+        TopicTable table = { seed, {} };
+        for (auto &slot : table.slots) { slot = -1; }
+        bool perfect = true;
+        for (size_t i = 0; i < sizeof(topicRoutes) / sizeof(topicRoutes[0]) && perfect; i++) {
+            int8_t &slot = table.slots[topicHash(topicRoutes[i].topic, seed) % TOPIC_SLOTS];
+            perfect = slot < 0;
+            slot = i;
+        }
+        if (perfect) { return table; }
+    }
+}
+
+constexpr TopicTable topicTable = topicTableBuild();
+static_assert(sizeof(topicRoutes) / sizeof(topicRoutes[0]) <= TOPIC_SLOTS, "more topics than slots");
+
+/* Parse a decimal number, optionally signed and with a fraction and exponent, from the
+ * bytes at p without reading at or past end. Returns the end of the number, or nullptr
+ * if there is no number or it is out of range */
+const uint8_t *parseNumber(const uint8_t *p, const uint8_t *end, double *value) {
+
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) { p++; }
+
+    /* Up to 19 significant digits in the mantissa, further ones only scale it */
+    uint64_t mantissa = 0;
+    int32_t scale = 0;
+    uint32_t digits = 0, significant = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        if (significant < 19) { mantissa = mantissa * 10 + (*p - '0'); significant += mantissa > 0; }
+        else { scale++; }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+            if (significant < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                significant += mantissa > 0;
+                scale--;
+            }
+        }
+    }
+    if (!digits) { return nullptr; }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const uint8_t *q = p + 1;
+        bool negativeExponent = q < end && *q == '-';
+        if (q < end && (*q == '-' || *q == '+')) { q++; }
+        int32_t exponent = 0;
+        const uint8_t *start = q;
+        for (; q < end && *q >= '0' && *q <= '9'; q++) {
+            if (exponent < 1000) { exponent = exponent * 10 + (*q - '0'); }
+        }
+        if (q == start) { return nullptr; }
+        scale += negativeExponent ? -exponent : exponent;
+        p = q;
+    }
+
+    /* Scale in steps of at most 1e22, stopping once the value overflows or underflows */
+    double result = mantissa;
+    for (; mantissa && scale > 22 && result <= 3.4e38; scale -= 22) { result *= powers[22]; }
+    for (; mantissa && scale < -22 && result > 0; scale += 22) { result /= powers[22]; }
+    if (mantissa && scale > 22) { return nullptr; }
+    if (mantissa && scale < -22) { result = 0; }
+    else if (mantissa) { result = scale < 0 ? result / powers[-scale] : result * powers[scale]; }
+    if (result > 3.4e38) { return nullptr; }
+    *value = negative ? -result : result;
+    return p;
+}
+
+/* Parse a payload that is a single number, allowing surrounding whitespace */
+bool mqttParseValue(const uint8_t *payload, unsigned int len, float *value) {
+
+    const uint8_t *end = payload + len;
+    double number;
+    while (payload < end && isspace(*payload)) { payload++; }
+    payload = parseNumber(payload, end, &number);
+    if (!payload) { return false; }
+    while (payload < end && isspace(*payload)) { payload++; }
+    *value = number;
+    return payload == end;
+}
+
+/* Route for a topic, or nullptr if it is not one of ours */
+const TopicRoute *mqttTopicRoute(const char *topic) {
+
+    int8_t index = topicTable.slots[topicHash(topic, topicTable.seed) % TOPIC_SLOTS];
+    if (index < 0 || strcmp(topic, topicRoutes[index].topic)) { return nullptr; }
+    return &topicRoutes[index];
+}
+
+/* Pull-style reader over a JSON payload in place, without allocating or unescaping. Each
+ * call consumes one token or value and returns false, leaving the position undefined, if
+ * the payload does not hold one there */
+#define JSON_MAX_DEPTH 32
+
+class JsonReader {
+    public:
+        JsonReader(const uint8_t *payload, unsigned int len) : p(payload), end(payload + len) {}
+        /* Skip whitespace and then the given structural character */
+        bool consume(uint8_t c) {
+            space();
+            if (p == end || *p != c) { return false; }
+            p++;
+            return true;
+        }
+        bool done() { space(); return p == end; }
+        /* A string, giving its raw bytes between the quotes */
+        bool string(const uint8_t **start, size_t *len) {
+            if (!consume('"')) { return false; }
+            const uint8_t *begin = p;
+            for (; p < end && *p != '"'; p++) {
+                if (*p == '\\' && ++p == end) { return false; }
+            }
+            if (p == end) { return false; }
+            if (start) { *start = begin; *len = p - begin; }
+            p++;
+            return true;
+        }
+        /* A number, or a string holding nothing but one as Home Assistant sends them */
+        bool number(double *value) {
+            space();
+            if (p < end && *p == '"') {
+                const uint8_t *start, *q;
+                size_t len;
+                if (!string(&start, &len)) { return false; }
+                q = parseNumber(start, start + len, value);
+                return q && q == start + len;
+            }
+            const uint8_t *q = parseNumber(p, end, value);
+            if (!q) { return false; }
+            p = q;
+            return true;
+        }
+        /* Any value, including nested objects and arrays up to JSON_MAX_DEPTH deep */
+        bool skip() {
+            uint32_t depth = 0, objects = 0;    // Bit n of objects is set if level n is an object
+            do {
+                space();
+                if (p == end) { return false; }
+                uint8_t c = *p;
+                if (c == '"') {
+                    if (!string(nullptr, nullptr)) { return false; }
+                } else if (c == '{' || c == '[') {
+                    if (depth == JSON_MAX_DEPTH) { return false; }
+                    objects = (objects & ~(1u << depth)) | ((c == '{') << depth);
+                    depth++;
+                    p++;
+                } else if (c == '}' || c == ']') {
+                    if (!depth || ((objects >> --depth) & 1) != (c == '}')) { return false; }
+                    p++;
+                } else if (c == ',' || c == ':') {
+                    if (!depth) { return false; }
+                    p++;
+                } else {
+                    const uint8_t *start = p;
+                    while (p < end && !isspace(*p) && !strchr(",:{}[]\"", *p)) { p++; }
+                    if (p == start) { return false; }
+                }
+            } while (depth);
+            return true;
+        }
+        const uint8_t *position() { return p; }
+        void rewind(const uint8_t *position) { p = position; }
+    private:
+        const uint8_t *p;
+        const uint8_t *end;
+        void space() { while (p < end && isspace(*p)) { p++; } }
+};
+
+/* Members of a JSON state message and the records they update */
+struct FieldRoute {
+    const char *name;
+    DataRecord DataSet::*record;
+};
+
+constexpr FieldRoute fieldRoutes[] = {
+    { "temperature", &DataSet::temperature },
+    { "humidity", &DataSet::humidity },
+    { "pressure", &DataSet::pressure },
+};
+#define FIELD_COUNT (sizeof(fieldRoutes) / sizeof(fieldRoutes[0]))
+
+/* Update a set from a JSON object such as {"temperature":21.4,"humidity":48}, with an
+ * optional "timestamp" in Unix seconds or milliseconds. Unknown members and known ones
+ * that are not numbers, such as "unavailable", are skipped; a malformed message updates
+ * nothing */
+void mqttHandleState(DataSet *set, const uint8_t *payload, unsigned int len) {
+
+    JsonReader json(payload, len);
+    double values[FIELD_COUNT], timestamp = 0;
+    bool present[FIELD_COUNT] = {};
+    const uint8_t *key;
+    size_t keyLen;
+
+    bool valid = json.consume('{');
+    if (valid && !json.consume('}')) {
+        do {
+            valid = json.string(&key, &keyLen) && json.consume(':');
+            if (!valid) { break; }
+            const uint8_t *start = json.position();
+            double value;
+            size_t field = 0;
+            while (field < FIELD_COUNT && (strlen(fieldRoutes[field].name) != keyLen ||
+                                           memcmp(fieldRoutes[field].name, key, keyLen))) { field++; }
+            bool isTimestamp = keyLen == 9 && !memcmp(key, "timestamp", 9);
+            if ((field < FIELD_COUNT || isTimestamp) && json.number(&value)) {
+                if (isTimestamp) { timestamp = value; }
+                else { values[field] = value; present[field] = true; }
+            } else {
+                json.rewind(start);
+                valid = json.skip();
+            }
+        } while (valid && json.consume(','));
+        valid = valid && json.consume('}');
+    }
+    if (!valid || !json.done()) {
+        Serial.println("[MQTT] ignored malformed JSON state");
+        return;
+    }
+
+    if (timestamp > 1e11) { timestamp /= 1000; }
+    time_t when = timestamp > 0 && timestamp < INT32_MAX ? (time_t)timestamp : 0;
+    bool changed = false;
+    for (size_t field = 0; field < FIELD_COUNT; field++) {
+        if (present[field]) {
+            DataRecord &record = set->*fieldRoutes[field].record;
+            changed |= record.setValue(values[field], when);
+            logSample(&record);
+        }
+    }
+    if (changed) { dispNotify(); }
+}
+
+WiFiClient mqttClient;
+PubSubClient pubsubclient(mqttClient);
+char mqttDeviceID[26];
+time_t connectRetryTime = (time_t)0;
 
 void mqttInit() {
 
+    uint64_t chipid = ESP.getEfuseMac();
+    snprintf(mqttDeviceID, sizeof(mqttDeviceID), "Weather-%04X%08X", (uint16_t)(chipid>>32),
+             (uint32_t)chipid);
+#if !EVENT_LOOP
     TaskHandle_t taskHandle;
-    xTaskCreatePinnedToCore(mqttTask, "Subscriber", 8192, nullptr, 2, &taskHandle, 1);
+    taskCreate(mqttTask, TASK_MQTT, &taskHandle);
+#endif
 }
 
 void mqttTask(void *param) {
 
+    while (true) {
+        mqttPoll();
+        mqttWait();
+    }
+}
+
+/* Connect if not connected and due a retry, then handle whatever the broker has sent */
+void mqttPoll() {
+
+    SchedBusy busy{TASK_MQTT};
+    logPoll();      // First, so that the log is replayed before any sample taken once the clock is set
     time_t now;
-    time_t connectRetryTime = (time_t)0;
-    WiFiClient espClient;
-    PubSubClient pubsubclient(espClient);
+    if (!pubsubclient.connected() && (now = time(nullptr)) > connectRetryTime) {
+        connectRetryTime = now + MQTT_RETRY_INTERVAL;
+        Serial.printf("[MQTT] connecting to %s\n", MQTT_BROKER);
+        pubsubclient.setServer(MQTT_BROKER, MQTT_PORT);
+        pubsubclient.setCallback(mqttHandleMessage);
+        if (pubsubclient.connect(mqttDeviceID, MQTT_USER, MQTT_PASS)) {
+            Serial.printf("[MQTT] connected as %s\n", mqttDeviceID);
+            pubsubclient.subscribe("enviro/#");
+        } else {
+            Serial.println("[MQTT] connection failed");
+        }
+    }
 
-    char sDeviceID[26];
-    uint64_t chipid = ESP.getEfuseMac();
-    snprintf(sDeviceID, sizeof(sDeviceID), "Weather-%04X%08X", (uint16_t)(chipid>>32), (uint32_t)chipid);
+    pubsubclient.loop();
+    mqttStats.wakeups++;
 
-    while (true) {
+    if (millis() - mqttStats.reportTime >= MQTT_STATS_INTERVAL) {
+        Serial.printf("[MQTT] %u wakeups, %u messages in the last %u s\n", mqttStats.wakeups,
+                      mqttStats.messages, (unsigned)(millis() - mqttStats.reportTime) / 1000);
+        mqttStats.wakeups = mqttStats.messages = 0;
+        mqttStats.reportTime = millis();
+    }
+}
 
-        /* If not connected, try connecting */
-        if (!pubsubclient.connected() && (now = time(nullptr)) > connectRetryTime) {
-            connectRetryTime = now + MQTT_RETRY_INTERVAL;
-            Serial.printf("[MQTT] connecting to %s\n", MQTT_BROKER);
-            pubsubclient.setServer(MQTT_BROKER, MQTT_PORT);
-            pubsubclient.setCallback(mqttHandleMessage);
-            if (pubsubclient.connect(sDeviceID, MQTT_USER, MQTT_PASS)) {
-                Serial.printf("[MQTT] connected as %s\n", sDeviceID);
-                pubsubclient.subscribe("enviro/#");
-            } else {
-                Serial.println("[MQTT] connection failed");
+/* How long, in milliseconds, until mqttPoll() is next needed if the socket it gives, if
+ * any, does not become readable first: a quarter of the keepalive period so that loop()
+ * sends pings in time, or until the retry while disconnected */
+uint32_t mqttTimeout(int *fd) {
+
+    *fd = -1;
+    if (!pubsubclient.connected()) {
+        time_t now = time(nullptr);
+        return connectRetryTime >= now ? (connectRetryTime - now + 1) * 1000 : 0;
+    }
+
+    /* The client buffers reads, so bytes may be waiting that select() cannot see */
+    if (mqttClient.available()) { return 0; }
+    *fd = mqttClient.fd();
+    return *fd < 0 ? 1 : MQTT_KEEPALIVE * 1000 / 4;
+}
+
+/* Sleep until mqttPoll() is next needed */
+void mqttWait() {
+
+    int fd;
+    uint32_t timeout = mqttTimeout(&fd);
+    if (fd < 0) {
+        vTaskDelay(pdMS_TO_TICKS(timeout));
+        return;
+    }
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(fd, &readable);
+    struct timeval wait = { (time_t)(timeout / 1000), (suseconds_t)(timeout % 1000) * 1000 };
+    select(fd + 1, &readable, nullptr, nullptr, &wait);
+}
+
+void mqttHandleMessage(char* topic, uint8_t* payload, unsigned int len) {
+
+    Serial.printf("[MQTT] received %s: %.*s\n", topic, len, (const char *)payload);
+    mqttStats.messages++;
+
+    const TopicRoute *route = mqttTopicRoute(topic);
+    float value;
+    if (!route) { return; }
+    if (!route->record) {
+        mqttHandleState(&(data.*route->set), payload, len);
+        return;
+    }
+    if (!mqttParseValue(payload, len, &value)) {
+        Serial.printf("[MQTT] ignored non-numeric payload on %s\n", topic);
+        return;
+    }
+    DataRecord &record = (data.*route->set).*route->record;
+    bool changed = record.setValue(value);
+    logSample(&record);
+    if (changed) { dispNotify(); }
+}
+
+/* ----- History log ----- */
+
+/* Each record's closed minutes, their range and last sample, are logged to flash so that
+ * the history survives a reset. They are gathered in RAM and appended as one block every
+ * LOG_INTERVAL_MS, or sooner if the batch fills, to keep writes and wear down, so a reset
+ * loses at most that long. Each block has a CRC, and one torn by a reset while it was
+ * written is skipped on replay. LOG_FILES files are written in turn, the oldest emptied
+ * once the newest is full, and once the clock is set after startup all are replayed,
+ * the oldest first, into the records, and logging starts. A day of the six records is
+ * 8640 entries, about 64 KB with the headers, so the files other than the one just
+ * emptied hold more than 24 hours */
+#ifndef LOG_HISTORY
+#define LOG_HISTORY 1
+#endif
+#ifndef LOG_INTERVAL_MS
+#define LOG_INTERVAL_MS (10 * 60 * 1000)
+#endif
+#define LOG_BATCH       256         // Entries per block at most
+#define LOG_SPAN        32          // Minutes the entries of a block can cover
+#define LOG_FILES       6
+#define LOG_FILE_BYTES  16000       // Four flash blocks each, 24 of the 128 KB partition's 32
+#define LOG_MAGIC       0x4E494D48  // "HMIN"
+#define LOG_TIME_VALID  1577836800  // 2020-01-01, the clock has not been set before then
+#ifndef LOG_REPLAY_MS
+#define LOG_REPLAY_MS   3000        // Time allowed for replaying
+#endif
+
+struct LogHeader {
+    uint32_t magic;
+    uint32_t generation;        // Of the file, one more than the one before it when it was started
+    uint32_t base;              // Unix minute the entries' minutes are from
+    uint32_t count;             // Entries following
+    uint32_t crc;               // CRC-32 of the header up to here and the entries
+};
+
+/* A record's minute, its range and last sample in the record's fixed point */
+struct __attribute__((packed)) LogEntry {
+    uint8_t record : 3;         // Index in logRecords
+    uint8_t minute : 5;         // Minutes after the block's base
+    int16_t min;
+    int16_t max;
+    int16_t last;
+};
+
+DataRecord *const logRecords[] = {
+    &data.indoor.temperature, &data.indoor.humidity, &data.indoor.pressure,
+    &data.outdoor.temperature, &data.outdoor.humidity, &data.outdoor.pressure,
+};
+#define LOG_RECORDS (sizeof(logRecords) / sizeof(logRecords[0]))
+static_assert(LOG_RECORDS <= 8, "LogEntry has three bits for the record");
+
+struct LogState {
+    bool mounted;               // Filesystem mounted
+    bool ready;                 // Clock set and the log replayed, so minutes are logged
+    uint8_t file;               // Index of the file appended to
+    uint32_t size;              // of that file
+    uint32_t generation;        // of that file
+    uint32_t flushTime;         // millis() of the last write
+    DataAccumulator minutes[LOG_RECORDS];   // Each record's open minute
+    int16_t last[LOG_RECORDS];              // and its newest sample
+    LogHeader header;           // Block being gathered, and its entries
+    LogEntry entries[LOG_BATCH];
+} logState;
+
+/* Path of a log file, by index */
+void logPath(char *path, size_t size, uint8_t file) {
+
+    snprintf(path, size, "/history%u.log", file);
+}
+
+/* Mount the filesystem, leaving logPoll() to replay the log once the clock is set */
+void logInit() {
+
+#if LOG_HISTORY
+    logState.mounted = LittleFS.begin(true);
+    if (!logState.mounted) {
+        Serial.println("[Log] cannot mount the filesystem, history will not be kept");
+    }
+#endif
+}
+
+/* Replay the log, as the clock is now set and the minutes' times can be checked against
+ * it, then start logging */
+void logReplay() {
+
+    /* The file started last is the one to append to. One without a good block, such as
+     * one written in an earlier format, or none found in the time allowed, is removed to
+     * free its space. The time allowed covers finding them as well as replaying */
+    uint32_t start = millis();
+    LogHeader header;
+    uint32_t generations[LOG_FILES];
+    char path[20];
+    uint8_t newest = 0;
+    for (uint8_t i = 0; i < LOG_FILES; i++) {
+        logPath(path, sizeof(path), i);
+        /* Opening a missing file to read logs an error on the ESP32, as none exist at first */
+        File file = LittleFS.exists(path) ? LittleFS.open(path, FILE_READ) : File();
+        generations[i] = logReadBlock(file, &header, start) ? header.generation + 1 : 0;  // Zero if none
+        size_t size = file ? file.size() : 0;
+        file.close();
+        if (!generations[i] && size) { LittleFS.remove(path); }
+        if (generations[i] > generations[newest]) { newest = i; }
+        if (i == newest) { logState.size = generations[i] ? size : 0; }
+    }
+    logState.file = newest;
+    logState.generation = generations[newest] ? generations[newest] - 1 : 0;
+
+    /* They are written in turn, so the oldest is the one after the newest. Minutes from
+     * before the 24 hours shown would only be expired again, so blocks of them are passed
+     * over, leaving the time allowed for the newest */
+    int32_t cutoff = time(nullptr) / 60 - DATA_MINUTES;
+    uint32_t minutes = 0, blocks = 0, skipped = 0;
+    bool complete = true;
+    for (uint8_t i = 1; i <= LOG_FILES && complete; i++) {
+        uint8_t file = (newest + i) % LOG_FILES;
+        if (!generations[file]) { continue; }
+        logPath(path, sizeof(path), file);
+        File f = LittleFS.open(path, FILE_READ);
+        while (logReadBlock(f, &header, start)) {
+            if ((int32_t)header.base + LOG_SPAN <= cutoff) {
+                skipped++;
+                continue;
+            }
+            for (uint32_t e = 0; e < header.count; e++) {
+                const LogEntry &entry = logState.entries[e];
+                int32_t minute = header.base + entry.minute;
+                if (entry.record >= LOG_RECORDS || minute < cutoff) { continue; }
+                /* A record that had a sample once the clock was set, before this was
+                 * called, keeps it rather than having older minutes piled on at its time */
+                DataRecord *record = logRecords[entry.record];
+                time_t when = (time_t)minute * 60;
+                if (record->getSnapshot().timestamp > when) { continue; }
+                for (int16_t value : { entry.min, entry.max, entry.last }) {
+                    record->setValue(record->decode(value), when);
+                }
+                minutes++;
             }
+            blocks++;
+            if (millis() - start >= LOG_REPLAY_MS) { break; }
         }
+        f.close();
+        complete = millis() - start < LOG_REPLAY_MS;
+    }
+    Serial.printf("[Log] replayed %u minutes from %u blocks, and passed over %u older, in %u ms%s\n",
+                  minutes, blocks, skipped, (unsigned)(millis() - start),
+                  complete ? "" : ", stopped at the time limit");
+    if (minutes) { dispNotify(); }
+    logState.flushTime = millis();
+    logState.ready = true;
+}
+
+/* Read the next block whose CRC checks out into the header and logState.entries. Anything
+ * else, such as a block torn by a reset, is skipped a byte at a time until a good block,
+ * which is slow, so that gives up once LOG_REPLAY_MS has passed since start. Returns false
+ * at the end of the file or on giving up */
+bool logReadBlock(File &file, struct LogHeader *header, uint32_t start) {
 
-        pubsubclient.loop();
-        vTaskDelay(1);
+    if (!file) { return false; }
+    while (true) {
+        size_t position = file.position();
+        if (file.read((uint8_t *)header, sizeof(*header)) != sizeof(*header)) { return false; }
+        size_t bytes = header->count * sizeof(LogEntry);
+        if (header->magic == LOG_MAGIC && header->count <= LOG_BATCH &&
+            file.read((uint8_t *)logState.entries, bytes) == bytes &&
+            logCrc(logCrc(0, header, offsetof(LogHeader, crc)), logState.entries, bytes) ==
+            header->crc) {
+            return true;
+        }
+        if (millis() - start >= LOG_REPLAY_MS) { return false; }
+        file.seek(position + 1);
     }
 }
 
-void mqttHandleMessage(char* topic, uint8_t* payload, unsigned int len) {
+/* Add a record's newest sample, as setValue() stored it, to its open minute, which is
+ * added to the block being gathered once a sample of a later minute arrives */
+void logSample(DataRecord *record) {
 
-    payload[len] = 0;
-    Serial.printf("[MQTT] received %s: %s\n", topic, payload);
-    float value = atof((char*)payload);
+    if (!logState.ready) { return; }
+    DataSnapshot snapshot = record->getSnapshot();
+    if (snapshot.timestamp < LOG_TIME_VALID) { return; }
+    uint8_t id = 0;
+    while (id < LOG_RECORDS && logRecords[id] != record) { id++; }
+    int32_t minute = snapshot.timestamp / 60;
+    int16_t value = record->encode(snapshot.value);
+    if (logState.minutes[id].count && logState.minutes[id].period != minute) { logMinute(id); }
+    logState.minutes[id].add(minute, value, value, 1);
+    logState.last[id] = value;
+}
+
+/* Add a record's open minute to the block being gathered, and close it. A block starts
+ * half its span before its first entry, as records that publish less often than once a
+ * minute close their minutes late */
+void logMinute(uint8_t id) {
 
-    if      (!strcmp(topic, "enviro/indoor/temperature")) { data.indoor.temperature.setValue(value); }
-    else if (!strcmp(topic, "enviro/indoor/humidity")) { data.indoor.humidity.setValue(value); }
-    else if (!strcmp(topic, "enviro/indoor/pressure")) { data.indoor.pressure.setValue(value); }
-    else if (!strcmp(topic, "enviro/outdoor/temperature")) { data.outdoor.temperature.setValue(value); }
-    else if (!strcmp(topic, "enviro/outdoor/humidity")) { data.outdoor.humidity.setValue(value); }
-    else if (!strcmp(topic, "enviro/outdoor/pressure")) { data.outdoor.pressure.setValue(value); }
-    data.dirty = true;
+    DataAccumulator &open = logState.minutes[id];
+    LogHeader &header = logState.header;
+    uint32_t minute = open.period;
+    if (header.count && (header.count == LOG_BATCH || minute < header.base ||
+                         minute - header.base >= LOG_SPAN)) { logFlush(); }
+    if (!header.count) { header.base = minute - LOG_SPAN / 2; }
+    uint8_t offset = minute - header.base;
+    logState.entries[header.count++] = { id, offset, open.min, open.max, logState.last[id] };
+    open.count = 0;
+}
+
+/* Replay the log once the clock is set, and from then on, every LOG_INTERVAL_MS, close
+ * the minutes that are over and write the block gathered. Until then samples are not
+ * logged, as their times are not yet known */
+void logPoll() {
+
+    if (!logState.ready) {
+        if (logState.mounted && time(nullptr) >= LOG_TIME_VALID) { logReplay(); }
+        return;
+    }
+    if (millis() - logState.flushTime < LOG_INTERVAL_MS) { return; }
+    int32_t minute = time(nullptr) / 60;
+    for (uint8_t id = 0; id < LOG_RECORDS; id++) {
+        if (logState.minutes[id].count && logState.minutes[id].period < minute) { logMinute(id); }
+    }
+    if (logState.header.count) { logFlush(); }
+    logState.flushTime = millis();
+}
+
+void logFlush() {
+
+    LogHeader &header = logState.header;
+    size_t bytes = header.count * sizeof(LogEntry);
+    if (logState.size + sizeof(header) + bytes > LOG_FILE_BYTES) {
+        logState.file = (logState.file + 1) % LOG_FILES;
+        logState.size = 0;
+        logState.generation++;
+    }
+    header.magic = LOG_MAGIC;
+    header.generation = logState.generation;
+    header.crc = logCrc(logCrc(0, &header, offsetof(LogHeader, crc)), logState.entries, bytes);
+    char path[20];
+    logPath(path, sizeof(path), logState.file);
+    File file = LittleFS.open(path, logState.size ? FILE_APPEND : FILE_WRITE);
+    bool written = file && file.write((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                   file.write((uint8_t *)logState.entries, bytes) == bytes;
+    file.close();
+    if (written) {
+        Serial.printf("[Log] wrote %u minutes to %s\n", header.count, path);
+        logState.size += sizeof(header) + bytes;
+    } else {
+        Serial.printf("[Log] failed to write %s\n", path);
+    }
+    logState.flushTime = millis();
+    header.count = 0;
+}
+
+/* CRC-32 as zlib's, a nibble at a time, continuing from a previous result or 0 */
+uint32_t logCrc(uint32_t crc, const void *data, size_t len) {
+
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (len--) {
+        crc = table[(crc ^ *p) & 0x0F] ^ crc >> 4;
+        crc = table[(crc ^ *p++ >> 4) & 0x0F] ^ crc >> 4;
+    }
+    return ~crc;
 }
 
 /* ----- Touch task ----- */
@@ -162,48 +1278,573 @@ void mqttHandleMessage(char* topic, uint8_t* payload, unsigned int len) {
 #define XPT2046_CLK     25
 #define XPT2046_CS      33
 
+/* Raw readings at the screen edges, swap MIN and MAX to flip an axis */
+#ifndef TOUCH_X_MIN
+#define TOUCH_X_MIN     200
+#define TOUCH_X_MAX     3700
+#define TOUCH_Y_MIN     240
+#define TOUCH_Y_MAX     3800
+#endif
+
+#define TOUCH_SAMPLES       3       // Readings per point, the median is taken
+#define TOUCH_READING_MS    4       // Between readings, the library repeats its last within 3 ms
+#define TOUCH_SAMPLE_MS     20      // Interval between points while touched
+#define TOUCH_RELEASE       2       // Untouched points in a row that end a touch
+#define TOUCH_LONG_MS       600     // Time held still for a long press
+#define TOUCH_SWIPE_PX      40      // Movement that makes a swipe rather than a tap
+#define TOUCH_QUEUE_LEN     8
+
+TaskHandle_t touchTaskHandle;
+QueueHandle_t touchEvents;          // TouchEvents for the display, dropped when full
+
+SPIClass touchSpi = SPIClass(VSPI);
+XPT2046_Touchscreen ts(XPT2046_CS); // Given no IRQ pin, as the library would attach its own handler
+
+/* The touch being followed, from pen down until it has been released */
+struct TouchState {
+    int16_t x, y;               // Latest point
+    int16_t startX, startY;     // First point, -1 until there is one
+    uint32_t startTime;
+    uint8_t released;           // Untouched points in a row
+    bool moved;                 // Gone further than a tap from the first point
+    bool longPress;             // Already reported as a long press
+} touchState;
+
+static const char *touchGestureNames[] = {
+    "tap", "long press", "swipe left", "swipe right", "swipe up", "swipe down"
+};
+
 void touchInit() {
 
-    TaskHandle_t taskHandle;
-    xTaskCreatePinnedToCore(touchTask, "Touch", 8192, nullptr, 2, &taskHandle, 1);
+    touchEvents = xQueueCreate(TOUCH_QUEUE_LEN, sizeof(TouchEvent));
+#if EVENT_LOOP
+    touchBegin();
+#else
+    taskCreate(touchTask, TASK_TOUCH, &touchTaskHandle);
+#endif
+}
+
+/* The controller pulls its IRQ line low on pen down, sampling starts from there */
+void IRAM_ATTR touchIsr() {
+
+#if EVENT_LOOP
+    eventWake();
+#else
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(touchTaskHandle, &woken);
+    if (woken) { portYIELD_FROM_ISR(); }
+#endif
 }
 
 void touchTask(void *param) {
 
-    /* Initialise the touch controller */
-    SPIClass vSpi = SPIClass(VSPI);
-    XPT2046_Touchscreen ts(XPT2046_CS, XPT2046_IRQ);
-    vSpi.begin(XPT2046_CLK, XPT2046_MISO, XPT2046_MOSI, XPT2046_CS);
-    ts.begin(vSpi);
+    touchBegin();
+    while (true) {
+
+        /* Sleep until pen down, then follow the touch until it is released */
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        touchStart();
+        while (touchStep()) { vTaskDelay(pdMS_TO_TICKS(TOUCH_SAMPLE_MS)); }
+
+        /* Reading the controller glitches its IRQ line, so forget wakeups from meanwhile */
+        ulTaskNotifyTake(pdTRUE, 0);
+    }
+}
+
+/* Initialise the touch controller, it is only read while the pen is down */
+void touchBegin() {
+
+    touchSpi.begin(XPT2046_CLK, XPT2046_MISO, XPT2046_MOSI, XPT2046_CS);
+    ts.begin(touchSpi);
     ts.setRotation(1);
+    pinMode(XPT2046_IRQ, INPUT);
+    attachInterrupt(digitalPinToInterrupt(XPT2046_IRQ), touchIsr, FALLING);
+}
 
-    while (true) {
-        if (ts.tirqTouched() && ts.touched()) {
-            TS_Point p = ts.getPoint();
-            // Serial.printf("[Touch] %d %d %d\n", p.x, p.y, p.z);
+void touchStart() {
+
+    touchState = {};
+    touchState.startX = touchState.startY = -1;
+}
+
+/* Take one point of the touch, to be called every TOUCH_SAMPLE_MS from touchStart().
+ * Returns false, having reported the gesture, once the touch has been released */
+bool touchStep() {
+
+    SchedBusy busy{TASK_TOUCH};
+    TouchState &t = touchState;
+    if (!touchPoint(&ts, &t.x, &t.y)) {
+        if (++t.released < TOUCH_RELEASE) { return true; }
+        if (t.startX < 0 || t.longPress) { return false; }
+        int16_t dx = t.x - t.startX, dy = t.y - t.startY;
+        if (!t.moved) { touchEmit(TOUCH_TAP, t.startX, t.startY); }
+        else if (abs(dx) > abs(dy)) {
+            touchEmit(dx < 0 ? TOUCH_SWIPE_LEFT : TOUCH_SWIPE_RIGHT, t.startX, t.startY);
         }
-        vTaskDelay(1);
+        else { touchEmit(dy < 0 ? TOUCH_SWIPE_UP : TOUCH_SWIPE_DOWN, t.startX, t.startY); }
+        return false;
+    }
+    t.released = 0;
+    if (t.startX < 0) { t.startX = t.x; t.startY = t.y; t.startTime = millis(); }
+    t.moved |= abs(t.x - t.startX) > TOUCH_SWIPE_PX || abs(t.y - t.startY) > TOUCH_SWIPE_PX;
+    if (!t.moved && !t.longPress && millis() - t.startTime >= TOUCH_LONG_MS) {
+        touchEmit(TOUCH_LONG_PRESS, t.startX, t.startY);
+        t.longPress = true;
+    }
+    return true;
+}
+
+/* Read the touch position in screen coordinates, as the median of several readings to
+ * reject noise. Returns false if the panel is not touched. The readings are spaced out,
+ * as the library only reads the controller again once 3 ms have passed */
+bool touchPoint(XPT2046_Touchscreen *ts, int16_t *x, int16_t *y) {
+
+    int16_t xs[TOUCH_SAMPLES], ys[TOUCH_SAMPLES];
+    for (uint8_t i = 0; i < TOUCH_SAMPLES; i++) {
+        if (i) { delay(TOUCH_READING_MS); }
+        if (!ts->touched()) { return false; }
+        TS_Point p = ts->getPoint();
+        /* Insertion sort as the readings arrive */
+        uint8_t j;
+        for (j = i; j > 0 && xs[j - 1] > p.x; j--) { xs[j] = xs[j - 1]; }
+        xs[j] = p.x;
+        for (j = i; j > 0 && ys[j - 1] > p.y; j--) { ys[j] = ys[j - 1]; }
+        ys[j] = p.y;
     }
+    *x = constrain(map(xs[TOUCH_SAMPLES / 2], TOUCH_X_MIN, TOUCH_X_MAX, 0, 319), 0, 319);
+    *y = constrain(map(ys[TOUCH_SAMPLES / 2], TOUCH_Y_MIN, TOUCH_Y_MAX, 0, 239), 0, 239);
+    return true;
+}
+
+void touchEmit(TouchGesture gesture, int16_t x, int16_t y) {
+
+    TouchEvent event = { gesture, x, y };
+    Serial.printf("[Touch] %s at %d,%d\n", touchGestureNames[gesture], x, y);
+    xQueueSend(touchEvents, &event, 0);
+    dispNotify();
 }
 
 /* ----- Display Task ---- */
 
+/* Smooth fonts, parsed once. TFT_eSPI::loadFont() parses the font header and allocates
+ * the glyph metric arrays on every call, so instead the metrics of each font are loaded
+ * at startup and swapped in and out of the sprite, never freed */
+class FontCache {
+    public:
+        void begin(TFT_eSPI *tft) {
+            const uint8_t *arrays[FONT_COUNT] = {
+                NotoSansBold12, NotoSansBold18, NotoSansBold24, NotoSansBold36
+            };
+            for (int i = 0; i < FONT_COUNT; i++) {
+                tft->loadFont(arrays[i]);
+                fonts[i] = { tft->gFont, tft->gUnicode, tft->gHeight, tft->gWidth,
+                             tft->gxAdvance, tft->gdY, tft->gdX, tft->gBitmap };
+                release(tft);
+            }
+        }
+        void select(TFT_eSPI *tft, Font font) {
+            Metrics &m = fonts[font];
+            tft->gFont = m.font;
+            tft->gUnicode = m.unicode;
+            tft->gHeight = m.height;
+            tft->gWidth = m.width;
+            tft->gxAdvance = m.xAdvance;
+            tft->gdY = m.dY;
+            tft->gdX = m.dX;
+            tft->gBitmap = m.bitmap;
+            tft->fontLoaded = true;
+        }
+        /* Detach the font without freeing its metrics, unlike TFT_eSPI::unloadFont() */
+        void release(TFT_eSPI *tft) {
+            tft->gUnicode = nullptr;
+            tft->gHeight = nullptr;
+            tft->gWidth = nullptr;
+            tft->gxAdvance = nullptr;
+            tft->gdY = nullptr;
+            tft->gdX = nullptr;
+            tft->gBitmap = nullptr;
+            tft->fontLoaded = false;
+        }
+    private:
+        struct Metrics {
+            TFT_eSPI::fontMetrics font;
+            uint16_t *unicode;
+            uint8_t *height;
+            uint8_t *width;
+            uint8_t *xAdvance;
+            int16_t *dY;
+            int8_t *dX;
+            uint32_t *bitmap;
+        } fonts[FONT_COUNT];
+} fontCache;
+
+/* Format a number as drawFloat() does: rounded half up, no sign if it rounds to zero */
+void formatFloat(char *str, size_t size, float value, uint8_t dp) {
+
+    float rounding = 0.5;
+    for (uint8_t i = 0; i < dp; i++) { rounding /= 10.0; }
+    bool negative = value < -rounding;
+    value = (negative ? -value : value) + rounding;
+    uint32_t whole = (uint32_t)value;
+    int len = snprintf(str, size, "%s%u%s", negative ? "-" : "", (unsigned)whole, dp ? "." : "");
+    value -= whole;
+    for (uint8_t i = 0; i < dp && len + 1 < (int)size; i++) {
+        value *= 10.0;
+        str[len++] = '0' + (uint8_t)value;
+        value -= (uint8_t)value;
+    }
+    str[len] = 0;
+}
+
+/* Numbers pre-rendered per font and colours. Each glyph is blended against the
+ * background once, on first use, and from then on copied straight into the sprite
+ * buffer rather than anti-aliased pixel by pixel */
+#define GLYPH_CHARS     "0123456789.-"
+#define GLYPH_STYLES    6
+
+class GlyphCache {
+    public:
+        /* Draw a number from formatFloat() centred on x, y like drawFloat() with MC_DATUM,
+         * in the font currently selected into the sprite */
+        void drawNumber(TFT_eSprite *spr, Font font, uint16_t fg, uint16_t bg, const char *str,
+                        int32_t x, int32_t y) {
+            Style *style = find(font, fg, bg);
+            if (!style) {
+                spr->setTextColor(fg, bg);
+                spr->drawString(str, x, y);
+                return;
+            }
+            x -= spr->textWidth(str) / 2;
+            y += spr->gFont.maxAscent - spr->gFont.yAdvance / 2;
+            for (const char *c = str; *c; c++) {
+                Glyph *glyph = find(spr, style, *c);
+                if (!glyph) { x += spr->gFont.spaceWidth; continue; }
+                blit(spr, glyph, x + glyph->dX, y - glyph->dY);
+                x += glyph->xAdvance;
+            }
+        }
+    private:
+        struct Glyph {
+            uint16_t *pixels;       // In sprite byte order, nullptr until rendered
+            uint8_t width;
+            uint8_t height;
+            uint8_t xAdvance;
+            int8_t dX;
+            int16_t dY;
+        };
+        struct Style {
+            Font font;
+            uint16_t fg;
+            uint16_t bg;
+            Glyph glyphs[sizeof(GLYPH_CHARS) - 1];
+        } styles[GLYPH_STYLES];
+        size_t count = 0;
+        Style *find(Font font, uint16_t fg, uint16_t bg) {
+            for (size_t i = 0; i < count; i++) {
+                if (styles[i].font == font && styles[i].fg == fg && styles[i].bg == bg) {
+                    return &styles[i];
+                }
+            }
+            if (count == GLYPH_STYLES) { return nullptr; }
+            styles[count] = {font, fg, bg, {}};
+            return &styles[count++];
+        }
+        Glyph *find(TFT_eSprite *spr, Style *style, char c) {
+            const char *slot = strchr(GLYPH_CHARS, c);
+            if (!slot) { return nullptr; }
+            Glyph *glyph = &style->glyphs[slot - GLYPH_CHARS];
+            if (!glyph->pixels) { render(spr, style, glyph, c); }
+            return glyph->pixels ? glyph : nullptr;
+        }
+        /* Blend the glyph's alpha bitmap from the font array as drawGlyph() would */
+        void render(TFT_eSprite *spr, Style *style, Glyph *glyph, char c) {
+            uint16_t index;
+            if (!spr->getUnicodeIndex(c, &index)) { return; }
+            size_t size = spr->gWidth[index] * spr->gHeight[index];
+            uint16_t *pixels = (uint16_t *)malloc(size * sizeof(uint16_t));
+            if (!pixels) { return; }
+            const uint8_t *alpha = spr->gFont.gArray + spr->gBitmap[index];
+            for (size_t i = 0; i < size; i++) {
+                uint8_t a = pgm_read_byte(alpha + i);
+                uint16_t color = a == 0xFF ? style->fg :
+                                 a ? spr->alphaBlend(a, style->fg, style->bg) : style->bg;
+                pixels[i] = color >> 8 | color << 8;
+            }
+            *glyph = {pixels, spr->gWidth[index], spr->gHeight[index], spr->gxAdvance[index],
+                      spr->gdX[index], spr->gdY[index]};
+        }
+        void blit(TFT_eSprite *spr, Glyph *glyph, int32_t x, int32_t y) {
+            int32_t w = spr->width(), h = spr->height();
+            int32_t x0 = x < 0 ? -x : 0, x1 = x + glyph->width > w ? w - x : glyph->width;
+            if (x1 <= x0) { return; }
+            uint16_t *img = (uint16_t *)spr->getPointer();
+            for (int32_t row = y < 0 ? -y : 0; row < glyph->height && y + row < h; row++) {
+                memcpy(img + (y + row) * w + x + x0, glyph->pixels + row * glyph->width + x0,
+                       (x1 - x0) * sizeof(uint16_t));
+            }
+        }
+} glyphCache;
+
+/* Widgets can instead be rendered into a 4-bpp sprite, a quarter of the RAM, which is
+ * expanded through its palette as it is pushed. The palette is black and a ramp of
+ * anti-aliasing shades for each text colour. The library's smooth fonts need 16 bpp, so
+ * text is drawn straight from the font's alpha bitmaps as the nearest shade */
+#ifndef DISP_SPRITE_4BPP
+#define DISP_SPRITE_4BPP 0
+#endif
+
+#if DISP_SPRITE_4BPP
+
+struct PaletteRamp {
+    uint16_t color;             // Full strength, the last shade
+    uint8_t first;              // Palette index of the faintest shade
+    uint8_t shades;
+};
+
+constexpr PaletteRamp paletteRamps[] = {
+    { TFT_GREEN, 1, 4 },
+    { 0x03E0, 5, 3 },
+    { TFT_MAROON, 8, 4 },
+    { TFT_NAVY, 12, 4 },
+};
+
+class PaletteText {
+    public:
+        void begin(TFT_eSprite *spr) {
+            palette[0] = TFT_BLACK;
+            for (auto &ramp : paletteRamps) {
+                for (uint8_t i = 1; i <= ramp.shades; i++) {
+                    /* The full shade is the colour itself, as alphaBlend() falls short at 255 */
+                    palette[ramp.first + i - 1] = i == ramp.shades ? ramp.color :
+                        spr->alphaBlend(i * 255 / ramp.shades, ramp.color, TFT_BLACK);
+                }
+            }
+            spr->createPalette(palette, 16);
+        }
+        /* Draw a string centred on x, y like drawString() with MC_DATUM, in the font
+         * currently selected into the sprite and one of the ramp colours */
+        void drawString(TFT_eSprite *spr, uint16_t fg, const char *str, int32_t x, int32_t y) {
+            const PaletteRamp *ramp = nullptr;
+            for (auto &r : paletteRamps) { if (r.color == fg) { ramp = &r; } }
+            if (!ramp) { return; }
+            x -= spr->textWidth(str) / 2;
+            y += spr->gFont.maxAscent - spr->gFont.yAdvance / 2;
+            for (; *str; str++) {
+                uint16_t index;
+                if (!spr->getUnicodeIndex(*str, &index)) { x += spr->gFont.spaceWidth; continue; }
+                drawGlyph(spr, ramp, index, x + spr->gdX[index], y - spr->gdY[index]);
+                x += spr->gxAdvance[index];
+            }
+        }
+    private:
+        uint16_t palette[16];
+        /* Two pixels a byte, the left one in the high nibble */
+        void drawGlyph(TFT_eSprite *spr, const PaletteRamp *ramp, uint16_t index, int32_t x, int32_t y) {
+            int32_t w = spr->width(), h = spr->height(), stride = (w + 1) / 2;
+            uint8_t *img = (uint8_t *)spr->getPointer();
+            const uint8_t *alpha = spr->gFont.gArray + spr->gBitmap[index];
+            for (int32_t row = 0; row < spr->gHeight[index]; row++, alpha += spr->gWidth[index]) {
+                if (y + row < 0 || y + row >= h) { continue; }
+                for (int32_t col = 0; col < spr->gWidth[index]; col++) {
+                    uint8_t shade = (pgm_read_byte(alpha + col) * ramp->shades + 127) / 255;
+                    if (!shade || x + col < 0 || x + col >= w) { continue; }
+                    uint8_t c = ramp->first + shade - 1;
+                    uint8_t &pixels = img[(y + row) * stride + (x + col) / 2];
+                    pixels = (x + col) & 1 ? (pixels & 0xF0) | c : (pixels & 0x0F) | c << 4;
+                }
+            }
+        }
+} paletteText;
+
+#endif
+
+/* Text in a widget, through whichever renderer suits the sprite's colour depth */
+void dispNumber(TFT_eSprite *spr, Font font, uint16_t fg, const char *str, int32_t x, int32_t y) {
+
+#if DISP_SPRITE_4BPP
+    paletteText.drawString(spr, fg, str, x, y);
+#else
+    glyphCache.drawNumber(spr, font, fg, TFT_BLACK, str, x, y);
+#endif
+}
+
+void dispString(TFT_eSprite *spr, uint16_t fg, const char *str, int32_t x, int32_t y) {
+
+#if DISP_SPRITE_4BPP
+    paletteText.drawString(spr, fg, str, x, y);
+#else
+    spr->setTextColor(fg, TFT_BLACK);
+    spr->drawString(str, x, y);
+#endif
+}
+
+/* Value widgets and where they are on the screen */
+struct Widget {
+    const char *label;
+    DataRecord *data;
+    uint8_t dp;
+    int16_t x;
+    int16_t y;
+    DataSnapshot shown;         // State last drawn, zero timestamp if never
+    WidgetText text;            // and the numbers as they were drawn
+    uint8_t *shadow;            // Copy of the sprite last pushed, nullptr if not kept
+    TFT_eSprite *graph;         // Sparkline under the widget, nullptr if not shown
+    uint32_t graphPoint;        // Newest point drawn, in pairs of graph columns
+    float graphLow;             // Range the sparkline was drawn to
+    float graphHigh;
+};
+
+Widget widgets[] = {
+    { "Temperature", &data.indoor.temperature, 1, 0, 30 },
+    { "Humidity", &data.indoor.humidity, 0, 0, 100 },
+    { "Pressure", &data.indoor.pressure, 0, 0, 170 },
+    { "Temperature", &data.outdoor.temperature, 1, 160, 30 },
+    { "Humidity", &data.outdoor.humidity, 0, 160, 100 },
+    { "Pressure", &data.outdoor.pressure, 0, 160, 170 },
+};
+
+/* Display instrumentation */
+struct DispStats {
+    uint32_t updates;           // Updates that pushed at least one widget
+    uint32_t pixelsPushed;      // Total pixels pushed to the LCD
+    uint32_t latency;           // Microseconds from message arrival to push complete, last update
+    uint32_t latencyMax;        // and worst update
+    uint32_t frameTime;         // Microseconds to render and push the widgets, last update
+    uint32_t bytesPushed;       // Total bytes sent to the LCD for widgets, windows and pixels
+    uint32_t unchanged;         // Widget changes skipped as they formatted the same as shown
+    std::atomic<uint32_t> pendingSince;     // Arrival time of the oldest message not yet shown
+} dispStats;
+
+#ifndef DISP_COALESCE_MS
+#define DISP_COALESCE_MS 20     // Time to gather a burst of messages into one update
+#endif
+
+/* Widgets can be pushed by DMA from a pair of sprites in turn, so that the next widget
+ * is rendered into one while the other is still being sent */
+#ifndef DISP_DMA
+#define DISP_DMA 0
+#endif
+#if DISP_DMA && DISP_SPRITE_4BPP
+#error "DISP_DMA pushes 16-bpp sprites, so cannot be combined with DISP_SPRITE_4BPP"
+#endif
+
+/* Widgets can keep a shadow of what the panel shows, so that only the pixels that have
+ * changed are sent. That takes a sprite's worth of RAM per widget, which with 16-bpp
+ * sprites is more than is likely to be free, in which case widgets are pushed whole */
+#ifndef DISP_DIFF
+#define DISP_DIFF 0
+#endif
+#define DISP_DIFF_GAP       6       // Unchanged pixels that cost about as much as a new window
+#define DISP_WINDOW_BYTES   11      // Commands and coordinates to set a window
+
+/* Sparklines of the last 24 hours under the widgets, a point for each pair of graph
+ * columns. Each is a 1-bpp sprite that is scrolled as time moves on, so only the newest
+ * point is drawn, unless the widget's range changes and all of them are, and it is
+ * pushed whole, which at 1440 pixels costs about as much as a few digits */
+#ifndef DISP_GRAPH
+#define DISP_GRAPH 1
+#endif
+#define GRAPH_WIDTH     (DATA_COLUMNS / 2)
+#define GRAPH_HEIGHT    10
+#define GRAPH_X         8           // Position relative to the widget, in the gap below it
+#define GRAPH_Y         60
+
+/* Full-screen chart of a widget's last 24 hours, a panel line for each graph column,
+ * opened by tapping the widget. In landscape the ILI9341's vertical scrolling moves the
+ * lines sideways, so column c is always drawn on line CHART_STRIP + c % DATA_COLUMNS and
+ * the scroll start moved to bring the newest to the right, one line drawn per column
+ * rather than the chart redrawn. The strip on the left is the fixed top area */
+#define CHART_STRIP     (TFT_HEIGHT - DATA_COLUMNS)     // Lines to the left of the plot
+#define CHART_MARGIN    10          // Rows kept clear above and below the plot
+#define ILI9341_VSCRDEF     0x33    // Vertical scrolling definition
+#define ILI9341_VSCRSADD    0x37    // Vertical scrolling start address
+static_assert(CHART_STRIP >= 30, "too little room beside the chart for its values");
+
+struct Chart {
+    struct Widget *widget;      // Widget charted, nullptr while the widgets are shown
+    uint32_t column;            // Newest column drawn
+    float low;                  // Range of the plot, padded so it need not change often
+    float high;
+    WidgetText text;            // Numbers shown in the strip
+} chart;
+
+TaskHandle_t dispTaskHandle;
+TFT_eSPI tft = TFT_eSPI();
+TFT_eSprite spr = TFT_eSprite(&tft);
+#if DISP_DMA
+TFT_eSprite sprDma = TFT_eSprite(&tft);
+#endif
+
 void dispInit() {
 
-    TaskHandle_t taskHandle;
-    xTaskCreatePinnedToCore(dispTask, "Display", 8192, nullptr, 2, &taskHandle, 1);
+#if EVENT_LOOP
+    dispBegin();
+#else
+    taskCreate(dispTask, TASK_DISPLAY, &dispTaskHandle);
+#endif
+}
+
+/* Have the display show new data, after DISP_COALESCE_MS to gather a burst of messages */
+void dispNotify() {
+
+    uint32_t none = 0;
+    dispStats.pendingSince.compare_exchange_strong(none, micros() | 1);     // Zero means none pending
+#if !EVENT_LOOP
+    xTaskNotifyGive(dispTaskHandle);
+#endif
 }
 
 void dispTask(void *param) {
 
-    TFT_eSPI tft = TFT_eSPI();
-    TFT_eSprite spr = TFT_eSprite(&tft);
+    dispBegin();
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(DISP_COALESCE_MS));
+        ulTaskNotifyTake(pdTRUE, 0);
+        dispUpdate();
+    }
+}
+
+void dispBegin() {
 
     /* Initialise the LCD controller */
     tft.init();
     tft.setRotation(1);
 
-    /* Clear the screen and draw the fixed items */
+    dispHome();
+
+    /* Create the sprite for rendering the widgets, and load the fonts it uses */
+#if DISP_SPRITE_4BPP
+    spr.setColorDepth(4);
+    spr.createSprite(160, 60);
+    paletteText.begin(&spr);
+#else
+    spr.createSprite(160, 60);
+#endif
+#if DISP_DMA
+    sprDma.createSprite(160, 60);
+    tft.initDMA();
+#endif
+    fontCache.begin(&spr);
+#if DISP_DIFF
+    for (auto &w : widgets) { w.shadow = (uint8_t *)malloc(dispSpriteBytes(&spr)); }
+#endif
+#if DISP_GRAPH
+    for (auto &w : widgets) {
+        w.graph = new TFT_eSprite(&tft);
+        w.graph->setColorDepth(1);
+        w.graph->createSprite(GRAPH_WIDTH, GRAPH_HEIGHT);
+        w.graph->setBitmapColor(TFT_DARKGREEN, TFT_BLACK);
+    }
+#endif
+}
+
+/* Clear the screen and draw the fixed items, leaving the widgets to be drawn afresh */
+void dispHome() {
+
+    chart.widget = nullptr;
+    dispScrollArea(0, TFT_HEIGHT);
+    dispScrollStart(0);
     tft.fillScreen(TFT_BLACK);
     tft.setTextColor(0x73EF, TFT_BLACK);
     tft.setTextDatum(MC_DATUM);
@@ -211,43 +1852,410 @@ void dispTask(void *param) {
     tft.drawString("Inside", 80, 15);
     tft.drawString("Outside", 240, 15);
     tft.unloadFont();
+    for (auto &w : widgets) {
+        w.shown.timestamp = 0;
+        w.graphPoint = 0;
+    }
+}
 
-    /* Create the sprite for rendering the widgets */
-    spr.createSprite(160, 60);
+/* Act on touches, then redraw whatever has changed since it was last shown */
+void dispUpdate() {
 
-    while (true) {
-        if (data.dirty) {
-            dispValueWidget(&spr, "Temperature", &data.indoor.temperature, 1); spr.pushSprite(0, 30);
-            dispValueWidget(&spr, "Humidity", &data.indoor.humidity, 0); spr.pushSprite(0, 100);
-            dispValueWidget(&spr, "Pressure", &data.indoor.pressure, 0); spr.pushSprite(0, 170);
-            dispValueWidget(&spr, "Temperature", &data.outdoor.temperature, 1); spr.pushSprite(160, 30);
-            dispValueWidget(&spr, "Humidity", &data.outdoor.humidity, 0); spr.pushSprite(160, 100);
-            dispValueWidget(&spr, "Pressure", &data.outdoor.pressure, 0); spr.pushSprite(160, 170);
-            data.dirty = false;
+    SchedBusy busy{TASK_DISPLAY};
+    uint32_t since = dispStats.pendingSince.exchange(0);
+    uint32_t start = micros();
+    TouchEvent event;
+    while (xQueueReceive(touchEvents, &event, 0) == pdTRUE) { dispTouch(event); }
+    uint32_t bytes = 0;
+    uint32_t pixels = chart.widget ? dispChart(&bytes) : dispWidgets(&bytes);
+    if (pixels) {
+        dispStats.updates++;
+        dispStats.pixelsPushed += pixels;
+        dispStats.bytesPushed += bytes;
+        dispStats.frameTime = micros() - start;
+        dispStats.latency = since ? micros() - since : 0;
+        if (dispStats.latency > dispStats.latencyMax) { dispStats.latencyMax = dispStats.latency; }
+        Serial.printf("[Display] pushed %u pixels, %u bytes in %u us, %u us after arrival\n", pixels,
+                      bytes, dispStats.frameTime, dispStats.latency);
+    }
+}
+
+/* Redraw the widgets whose data has changed since they were last shown. Returns the
+ * pixels pushed and adds the bytes sent */
+uint32_t dispWidgets(uint32_t *bytes) {
+
+    uint32_t pixels = 0;
+    TFT_eSprite *target = &spr;
+#if DISP_DMA
+    tft.startWrite();
+#endif
+    for (auto &w : widgets) {
+        DataSnapshot snapshot = w.data->getSnapshot();
+        if (!snapshot.timestamp || (w.shown.timestamp && snapshot.value == w.shown.value &&
+            snapshot.minimum == w.shown.minimum && snapshot.maximum == w.shown.maximum &&
+            snapshot.column == w.shown.column)) { continue; }
+        bool shown = w.shown.timestamp;
+        w.shown = snapshot;
+        /* Most new samples round to the numbers already shown, which formatting, far
+         * cheaper than rendering and pushing the widget, finds out */
+        WidgetText text = {};
+        formatFloat(text.value, sizeof(text.value), snapshot.value, w.dp);
+        formatFloat(text.maximum, sizeof(text.maximum), snapshot.maximum, w.dp);
+        formatFloat(text.minimum, sizeof(text.minimum), snapshot.minimum, w.dp);
+        bool changed = !shown || memcmp(&text, &w.text, sizeof(text));
+        if (changed) {
+            w.text = text;
+            dispValueWidget(target, w.label, text);
         }
-        vTaskDelay(1000);
+        /* Only now, with the widget rendered while the previous one's push ran, does
+         * the sparkline wait for that push to finish before pushing itself */
+        pixels += dispGraph(&w, snapshot, bytes);
+        if (!changed) {
+            dispStats.unchanged++;
+            continue;
+        }
+        if (w.shadow && shown) {
+            pixels += dispPushDiff(target, w.x, w.y, w.shadow, bytes);
+        } else {
+            dispPushSpan(target, w.x, w.y, 0, 0, target->width(), target->height());
+            pixels += target->width() * target->height();
+            *bytes += DISP_WINDOW_BYTES + 2 * target->width() * target->height();
+        }
+        if (w.shadow) { memcpy(w.shadow, target->getPointer(), dispSpriteBytes(target)); }
+#if DISP_DMA
+        target = target == &spr ? &sprDma : &spr;
+#endif
+    }
+#if DISP_DMA
+    tft.dmaWait();
+    tft.endWrite();
+#endif
+    return pixels;
+}
+
+/* A tap on a widget opens its chart, and a tap on the chart goes back to the widgets */
+void dispTouch(const TouchEvent &event) {
+
+    if (event.gesture != TOUCH_TAP) { return; }
+    if (chart.widget) {
+        dispHome();
+        return;
+    }
+    for (auto &w : widgets) {
+        if (event.x >= w.x && event.x < w.x + spr.width() &&
+            event.y >= w.y && event.y < w.y + GRAPH_Y + GRAPH_HEIGHT) {
+            dispChartOpen(&w);
+            return;
+        }
+    }
+}
+
+size_t dispSpriteBytes(TFT_eSprite *spr) {
+
+    return spr->width() * spr->height() * (DISP_SPRITE_4BPP ? 4 : 16) / 8;
+}
+
+/* Push part of a row, or the whole sprite, to where the widget is on the screen */
+void dispPushSpan(TFT_eSprite *spr, int32_t x, int32_t y, int32_t sx, int32_t sy, int32_t sw,
+                  int32_t sh) {
+
+#if DISP_DMA
+    /* Waits for the previous push, which is from this sprite or the other one, never
+     * one being rendered into. A span of one row is contiguous in the sprite */
+    uint16_t *img = (uint16_t *)spr->getPointer() + sy * spr->width() + sx;
+    tft.pushImageDMA(x + sx, y + sy, sw, sh, img);
+#else
+    spr->pushSprite(x + sx, y + sy, sx, sy, sw, sh);
+#endif
+}
+
+/* Push the pixels that differ from the shadow, a row at a time as spans that run from
+ * one changed pixel to the next unless DISP_DIFF_GAP unchanged ones come between them.
+ * Returns the pixels pushed and adds the bytes sent */
+uint32_t dispPushDiff(TFT_eSprite *spr, int32_t x, int32_t y, const uint8_t *shadow, uint32_t *bytes) {
+
+    const uint8_t *img = (const uint8_t *)spr->getPointer();
+    int32_t w = spr->width(), h = spr->height();
+    uint32_t pixels = 0;
+    for (int32_t row = 0; row < h; row++) {
+#if DISP_SPRITE_4BPP
+        /* Compared a byte, so two pixels, at a time */
+        const uint8_t *line = img + row * w / 2, *old = shadow + row * w / 2;
+        int32_t step = 2;
+        auto differs = [&](int32_t i) { return line[i / 2] != old[i / 2]; };
+#else
+        const uint16_t *line = (const uint16_t *)img + row * w;
+        const uint16_t *old = (const uint16_t *)shadow + row * w;
+        int32_t step = 1;
+        auto differs = [&](int32_t i) { return line[i] != old[i]; };
+#endif
+        for (int32_t i = 0; i < w; i += step) {
+            if (!differs(i)) { continue; }
+            int32_t start = i, end = i + step;
+            for (int32_t j = end; j < w && j - end < DISP_DIFF_GAP; j += step) {
+                if (differs(j)) { end = j + step; }
+            }
+            i = end - step;
+            dispPushSpan(spr, x, y, start, row, end - start, 1);
+            pixels += end - start;
+            *bytes += DISP_WINDOW_BYTES + 2 * (end - start);
+        }
+    }
+    return pixels;
+}
+
+/* Bring a widget's sparkline up to date with the snapshot and push what has changed.
+ * Returns the pixels pushed and adds the bytes sent */
+uint32_t dispGraph(struct Widget *w, const DataSnapshot &snapshot, uint32_t *bytes) {
+
+    if (!w->graph) { return 0; }
+    uint32_t point = snapshot.column / 2;
+    uint32_t from;
+    if (snapshot.minimum != w->graphLow || snapshot.maximum != w->graphHigh ||
+        point - w->graphPoint >= GRAPH_WIDTH) {
+        w->graphLow = snapshot.minimum;
+        w->graphHigh = snapshot.maximum;
+        from = point - GRAPH_WIDTH + 1;
+    } else if (point != w->graphPoint) {
+        w->graph->scroll(-(int16_t)(point - w->graphPoint));
+        from = w->graphPoint;       // May have had samples added since it was drawn
+    } else {
+        from = point;
+    }
+    w->graphPoint = point;
+    for (uint32_t p = from; p != point + 1; p++) {
+        dispGraphPoint(w->graph, w->data, p, GRAPH_WIDTH - 1 - (point - p), w->graphLow, w->graphHigh);
+    }
+#if DISP_DMA
+    tft.dmaWait();
+#endif
+    /* All of it, as TFT_eSPI pushes part of a 1-bpp sprite from the start of each row */
+    w->graph->pushSprite(w->x + GRAPH_X, w->y + GRAPH_Y);
+    *bytes += DISP_WINDOW_BYTES + 2 * GRAPH_WIDTH * GRAPH_HEIGHT;
+    return GRAPH_WIDTH * GRAPH_HEIGHT;
+}
+
+/* Draw the range of a pair of graph columns as a vertical line, scaled so low to high
+ * fills the sparkline. Ranges outside that, from the edge of the window, are clipped */
+void dispGraphPoint(TFT_eSprite *graph, DataRecord *data, uint32_t point, int32_t x, float low,
+                    float high) {
+
+    graph->drawFastVLine(x, 0, GRAPH_HEIGHT, 0);
+    float lo, hi, lo2, hi2;
+    bool first = data->getColumn(point * 2, lo, hi), second = data->getColumn(point * 2 + 1, lo2, hi2);
+    if (!first && !second) { return; }
+    if (!first || (second && lo2 < lo)) { lo = lo2; }
+    if (!first || (second && hi2 > hi)) { hi = hi2; }
+    int32_t top = GRAPH_HEIGHT / 2, bottom = GRAPH_HEIGHT / 2;
+    if (high > low) {
+        top = GRAPH_HEIGHT - 1 - lroundf((hi - low) * (GRAPH_HEIGHT - 1) / (high - low));
+        bottom = GRAPH_HEIGHT - 1 - lroundf((lo - low) * (GRAPH_HEIGHT - 1) / (high - low));
+    }
+    top = constrain(top, 0, GRAPH_HEIGHT - 1);
+    bottom = constrain(bottom, 0, GRAPH_HEIGHT - 1);
+    graph->drawFastVLine(x, top, bottom - top + 1, 1);
+}
+
+void dispChartOpen(struct Widget *w) {
+
+    Serial.printf("[Display] chart of %s %s\n", w->x < 160 ? "inside" : "outside", w->label);
+    chart = {};
+    chart.widget = w;
+    chart.low = INFINITY;           // Drawn with no range, so the first update draws it all
+    chart.high = -INFINITY;
+    tft.fillScreen(TFT_BLACK);
+    tft.drawFastVLine(CHART_STRIP - 1, 0, tft.height(), 0x73EF);
+    dispScrollArea(CHART_STRIP, DATA_COLUMNS);
+}
+
+/* Bring the chart up to date with its record. Columns from the newest drawn on are drawn,
+ * as it may have had samples added since, unless the plot's range no longer suits the
+ * data, as it falls outside or fills less than half of it, and every column is redrawn.
+ * Returns the pixels pushed and adds the bytes sent */
+uint32_t dispChart(uint32_t *bytes) {
+
+    Widget *w = chart.widget;
+    DataSnapshot snapshot = w->data->getSnapshot();
+    if (!snapshot.timestamp) { return 0; }
+    uint32_t pixels = 0, from = chart.column;
+    float unit = 1.0;
+    for (uint8_t i = 0; i < w->dp; i++) { unit /= 10.0; }
+    float pad = (snapshot.maximum - snapshot.minimum) / 4 + unit;
+    if (snapshot.minimum < chart.low || snapshot.maximum > chart.high ||
+        chart.high - chart.low > 2 * (snapshot.maximum - snapshot.minimum + 2 * pad) ||
+        snapshot.column - chart.column >= DATA_COLUMNS) {
+        chart.low = snapshot.minimum - pad;
+        chart.high = snapshot.maximum + pad;
+        from = snapshot.column - DATA_COLUMNS + 1;
+    }
+    for (uint32_t c = from; c != snapshot.column + 1; c++) {
+        pixels += dispChartColumn(w->data, c, bytes);
+    }
+    if (snapshot.column != chart.column) {
+        dispScrollStart(CHART_STRIP + (snapshot.column + 1) % DATA_COLUMNS);
+        *bytes += 3;
+    }
+    chart.column = snapshot.column;
+
+    WidgetText text = {};
+    formatFloat(text.value, sizeof(text.value), snapshot.value, w->dp);
+    formatFloat(text.maximum, sizeof(text.maximum), snapshot.maximum, w->dp);
+    formatFloat(text.minimum, sizeof(text.minimum), snapshot.minimum, w->dp);
+    if (memcmp(&text, &chart.text, sizeof(text))) {
+        chart.text = text;
+        pixels += dispChartStrip(text, bytes);
     }
+    return pixels;
 }
 
-void dispValueWidget(TFT_eSprite *spr, const char *label, DataRecord *data, uint8_t dp) {
+/* Draw a column's range on its line, and clear the rest of the line */
+uint32_t dispChartColumn(DataRecord *data, uint32_t column, uint32_t *bytes) {
+
+    int32_t x = CHART_STRIP + column % DATA_COLUMNS, h = tft.height();
+    float low, high;
+    if (!data->getColumn(column, low, high)) {
+        tft.drawFastVLine(x, 0, h, TFT_BLACK);
+        *bytes += DISP_WINDOW_BYTES + 2 * h;
+        return h;
+    }
+    int32_t top = dispChartRow(high), bottom = dispChartRow(low);
+    tft.drawFastVLine(x, 0, top, TFT_BLACK);
+    tft.drawFastVLine(x, top, bottom - top + 1, TFT_GREEN);
+    tft.drawFastVLine(x, bottom + 1, h - bottom - 1, TFT_BLACK);
+    *bytes += 3 * DISP_WINDOW_BYTES + 2 * h;
+    return h;
+}
+
+int32_t dispChartRow(float value) {
+
+    int32_t rows = tft.height() - 2 * CHART_MARGIN;
+    int32_t row = CHART_MARGIN + lroundf((chart.high - value) * (rows - 1) / (chart.high - chart.low));
+    return constrain(row, 0, tft.height() - 1);
+}
+
+/* The highest, latest and lowest values, at the top, middle and bottom of the strip */
+uint32_t dispChartStrip(const WidgetText &text, uint32_t *bytes) {
+
+    const struct { const char *str; uint16_t color; int32_t y; } values[] = {
+        { text.maximum, TFT_MAROON, 10 },
+        { text.value, TFT_GREEN, tft.height() / 2 },
+        { text.minimum, TFT_NAVY, tft.height() - 10 },
+    };
+    int32_t w = CHART_STRIP - 1;
+    fontCache.select(&spr, FONT_12);
+    for (auto &v : values) {
+        spr.fillSprite(TFT_BLACK);
+        dispNumber(&spr, FONT_12, v.color, v.str, w / 2, 10);
+        spr.pushSprite(0, v.y - 10, 0, 0, w, 20);
+        *bytes += DISP_WINDOW_BYTES + 2 * w * 20;
+    }
+    fontCache.release(&spr);
+    return 3 * w * 20;
+}
+
+/* The scrolling area, which with the rotation used runs left to right from line top */
+void dispScrollArea(uint16_t top, uint16_t lines) {
+
+    uint16_t bottom = TFT_HEIGHT - top - lines;
+    tft.writecommand(ILI9341_VSCRDEF);
+    tft.writedata(top >> 8);
+    tft.writedata(top & 0xFF);
+    tft.writedata(lines >> 8);
+    tft.writedata(lines & 0xFF);
+    tft.writedata(bottom >> 8);
+    tft.writedata(bottom & 0xFF);
+}
+
+/* The line shown first in the scrolling area */
+void dispScrollStart(uint16_t line) {
+
+    tft.writecommand(ILI9341_VSCRSADD);
+    tft.writedata(line >> 8);
+    tft.writedata(line & 0xFF);
+}
+
+void dispValueWidget(TFT_eSprite *spr, const char *label, const WidgetText &text) {
 
     spr->fillSprite(TFT_BLACK);
     spr->setTextDatum(MC_DATUM);
 
-    spr->loadFont(NotoSansBold36);
-    spr->setTextColor(TFT_GREEN, TFT_BLACK);
-    spr->drawFloat(data->getValue(), dp, 50, 40);
-    spr->unloadFont();
+    fontCache.select(spr, FONT_36);
+    dispNumber(spr, FONT_36, TFT_GREEN, text.value, 50, 40);
+
+    fontCache.select(spr, FONT_12);
+    dispString(spr, 0x03E0, label, 50, 10);
+
+    fontCache.select(spr, FONT_24);
+    dispNumber(spr, FONT_24, TFT_MAROON, text.maximum, 130, 15);
+    dispNumber(spr, FONT_24, TFT_NAVY, text.minimum, 130, 45);
+    fontCache.release(spr);
+}
+
+/* ----- Event loop ----- */
+
+#if EVENT_LOOP
+
+int eventFd = -1;                   // Written by ISRs to wake the event loop
+
+void eventInit() {
+
+    esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    esp_vfs_eventfd_register(&config);
+    eventFd = eventfd(0, EFD_SUPPORT_ISR);
+}
 
-    spr->loadFont(NotoSansBold12);
-    spr->setTextColor(0x03E0, TFT_BLACK);
-    spr->drawString(label, 50, 10);
-    spr->unloadFont();
+/* Wake the event loop, safe from an ISR */
+void IRAM_ATTR eventWake() {
 
-    spr->loadFont(NotoSansBold24);
-    spr->setTextColor(TFT_MAROON, TFT_BLACK);
-    spr->drawFloat(data->getMaximum(), dp, 130, 15);
-    spr->setTextColor(TFT_NAVY, TFT_BLACK);
-    spr->drawFloat(data->getMinimum(), dp, 130, 45);
-    spr->unloadFont();
+    uint64_t count = 1;
+    write(eventFd, &count, sizeof(count));
 }
+
+/* Wait for the first of the MQTT socket, an ISR, the next touch sample or the end of the
+ * display's coalescing delay, then run the handlers that are due */
+void eventStep() {
+
+    static bool touching = false;
+    static uint32_t touchTime;      // millis() of the next touch sample
+
+    int mqttFd;
+    uint32_t start = millis();
+    uint32_t mqttDue = mqttTimeout(&mqttFd);
+    uint32_t timeout = mqttDue;
+    uint32_t since = dispStats.pendingSince.load();
+    if (since) {
+        uint32_t waited = (micros() - since) / 1000;
+        uint32_t dispDue = waited < DISP_COALESCE_MS ? DISP_COALESCE_MS - waited : 0;
+        if (dispDue < timeout) { timeout = dispDue; }
+    }
+    if (touching) {
+        uint32_t touchDue = (int32_t)(touchTime - start) > 0 ? touchTime - start : 0;
+        if (touchDue < timeout) { timeout = touchDue; }
+    }
+
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(eventFd, &readable);
+    if (mqttFd >= 0) { FD_SET(mqttFd, &readable); }
+    struct timeval wait = { (time_t)(timeout / 1000), (suseconds_t)(timeout % 1000) * 1000 };
+    if (select((mqttFd > eventFd ? mqttFd : eventFd) + 1, &readable, nullptr, nullptr, &wait) <= 0) {
+        FD_ZERO(&readable);
+    }
+
+    /* Pen down. Reading the controller glitches its IRQ line, so wakeups while following
+     * a touch are ignored, and one just after it ends only finds nothing to follow */
+    if (FD_ISSET(eventFd, &readable)) {
+        uint64_t count;
+        read(eventFd, &count, sizeof(count));
+        if (!touching) { touchStart(); touching = true; touchTime = millis(); }
+    }
+    if (touching && (int32_t)(millis() - touchTime) >= 0) {
+        touching = touchStep();
+        touchTime += TOUCH_SAMPLE_MS;
+    }
+    if ((mqttFd >= 0 && FD_ISSET(mqttFd, &readable)) || millis() - start >= mqttDue) { mqttPoll(); }
+    since = dispStats.pendingSince.load();
+    if (since && micros() - since >= DISP_COALESCE_MS * 1000) { dispUpdate(); }
+}
+
+#endif
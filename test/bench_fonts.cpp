@@ -0,0 +1,63 @@
+/* Time the fonts take in a frame of the six value widgets, each of which draws in three
+ * smooth fonts: loaded and unloaded for each as before the font cache, which parses the
+ * font and allocates and frees its metric arrays every time, against swapped in and out
+ * of the sprite by FontCache::select() and release(). Rendering a frame's widgets through
+ * the cache is timed too, for the share of the frame that loading would add. The
+ * stand-in's loadFont() parses and allocates as the library's does */
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define BENCH_FRAMES    20000
+#define BENCH_WIDGETS   6
+
+static const uint8_t *const benchArrays[] = { NotoSansBold36, NotoSansBold12, NotoSansBold24 };
+static const Font benchFonts[] = { FONT_36, FONT_12, FONT_24 };
+
+int main() {
+
+    TFT_eSprite sprite(&tft);
+    sprite.createSprite(160, 60);
+    fontCache.begin(&sprite);
+
+    uint64_t begin = benchNanos();
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        for (int w = 0; w < BENCH_WIDGETS; w++) {
+            for (const uint8_t *array : benchArrays) {
+                sprite.loadFont(array);
+                sprite.unloadFont();
+            }
+        }
+    }
+    double loaded = (double)(benchNanos() - begin) / BENCH_FRAMES;
+
+    begin = benchNanos();
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        for (int w = 0; w < BENCH_WIDGETS; w++) {
+            for (Font font : benchFonts) { fontCache.select(&sprite, font); }
+            fontCache.release(&sprite);
+        }
+        __asm__ volatile("" ::: "memory");     // Keep the stores to the sprite in the loop
+    }
+    double cached = (double)(benchNanos() - begin) / BENCH_FRAMES;
+
+    WidgetText text = {};
+    begin = benchNanos();
+    for (int f = 0; f < BENCH_FRAMES / 10; f++) {
+        for (int w = 0; w < BENCH_WIDGETS; w++) {
+            formatFloat(text.value, sizeof(text.value), 18.0 + (f + w) % 800 * 0.01, 1);
+            formatFloat(text.maximum, sizeof(text.maximum), 26.0, 1);
+            formatFloat(text.minimum, sizeof(text.minimum), 12.0, 1);
+            dispValueWidget(&sprite, "Temperature", text);
+        }
+    }
+    double frame = (double)(benchNanos() - begin) / (BENCH_FRAMES / 10);
+
+    printf("%-24s %8s\n", "Fonts per frame", "us/frame");
+    printf("%-24s %8.2f\n", "loadFont()/unloadFont()", loaded / 1000);
+    printf("%-24s %8.2f\n", "FontCache", cached / 1000);
+    printf("%-24s %8.2f  (%.0f%% of a %.1f us frame of rendering)\n", "Saved", (loaded - cached) / 1000,
+           100 * (loaded - cached) / frame, frame / 1000);
+    CHECK(cached < loaded, "the cache took longer than loading the fonts");
+    return testResult();
+}
@@ -0,0 +1,39 @@
+/* Cost per sample of DataRecord::setValue(), which updates the value, the tiers of
+ * history, the graph columns and the 24-hour high and low, with samples arriving at
+ * 1, 10 and 100 Hz. Each rate is run for a day of simulated time, so the history is at
+ * its steady state, then timed over the following hour */
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define BENCH_WARMUP    (24*60*60)      // Simulated seconds before timing
+#define BENCH_TIMED     (60*60)         // Simulated seconds timed
+
+/* Temperature wandering through a daily cycle, with noise of a few hundredths */
+static float benchValue(uint32_t second) {
+
+    return 20.0 + 3.0 * sinf(second * 2 * M_PI / (24*60*60)) + (int)(testRandom() % 7 - 3) * 0.01;
+}
+
+int main() {
+
+    static const int rates[] = {1, 10, 100};
+    time_t start = time(nullptr) - 2 * BENCH_WARMUP;
+    printf("Rate      Samples  ns/sample\n");
+    for (int rate : rates) {
+        DataRecord *record = new DataRecord(0.01);
+        for (uint32_t s = 0; s < BENCH_WARMUP; s++) {
+            for (int i = 0; i < rate; i++) { record->setValue(benchValue(s), start + s); }
+        }
+        size_t count = (size_t)BENCH_TIMED * rate;
+        float *values = new float[count];
+        for (size_t i = 0; i < count; i++) { values[i] = benchValue(BENCH_WARMUP + i / rate); }
+        uint64_t begin = benchNanos();
+        for (size_t i = 0; i < count; i++) { record->setValue(values[i], start + BENCH_WARMUP + i / rate); }
+        uint64_t elapsed = benchNanos() - begin;
+        printf("%3d Hz %10zu %10.1f\n", rate, count, (double)elapsed / count);
+        delete[] values;
+        delete record;
+    }
+    return 0;
+}
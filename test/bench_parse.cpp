@@ -0,0 +1,48 @@
+/* Time to parse a numeric MQTT payload with mqttParseValue(), which works on the bytes
+ * and length PubSubClient hands over, against atof() and strtof(), which need them
+ * copied and terminated first (the copy is not timed). The payloads are the sort
+ * sensors publish, and the results are checked to agree */
+
+#include <math.h>
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define BENCH_PARSES    2000000
+
+static const char *benchPayloads[] = { "21.4", "-3.75", "48", "1013.2", "55.67", "0.5", "1.0132e3", "19.875" };
+#define BENCH_PAYLOADS (sizeof(benchPayloads) / sizeof(benchPayloads[0]))
+
+int main() {
+
+    size_t lens[BENCH_PAYLOADS];
+    for (size_t i = 0; i < BENCH_PAYLOADS; i++) {
+        lens[i] = strlen(benchPayloads[i]);
+        float value;
+        CHECK(mqttParseValue((const uint8_t *)benchPayloads[i], lens[i], &value) && value == strtof(benchPayloads[i], nullptr),
+              "\"%s\" parsed as %g", benchPayloads[i], value);
+    }
+
+    volatile float sink = 0;
+    uint64_t begin = benchNanos();
+    for (int i = 0; i < BENCH_PARSES; i++) {
+        float value = 0;
+        mqttParseValue((const uint8_t *)benchPayloads[i % BENCH_PAYLOADS], lens[i % BENCH_PAYLOADS], &value);
+        sink = sink + value;
+    }
+    double parse = (double)(benchNanos() - begin) / BENCH_PARSES;
+
+    begin = benchNanos();
+    for (int i = 0; i < BENCH_PARSES; i++) { sink = sink + atof(benchPayloads[i % BENCH_PAYLOADS]); }
+    double atofTime = (double)(benchNanos() - begin) / BENCH_PARSES;
+
+    begin = benchNanos();
+    for (int i = 0; i < BENCH_PARSES; i++) { sink = sink + strtof(benchPayloads[i % BENCH_PAYLOADS], nullptr); }
+    double strtofTime = (double)(benchNanos() - begin) / BENCH_PARSES;
+
+    printf("Parser            ns/payload\n");
+    printf("mqttParseValue() %10.1f\n", parse);
+    printf("atof()           %10.1f\n", atofTime);
+    printf("strtof()         %10.1f\n", strtofTime);
+    return testResult();
+}
@@ -0,0 +1,57 @@
+/* Bytes sent over SPI to show a reading that has moved by 0.1 °C, the usual change, as
+ * counted by the stand-in panel and by the display code's own estimate. Build it as
+ * bench-push, which pushes each changed widget whole, and as bench-push-diff, built
+ * with DISP_DIFF=1, which pushes only the spans that differ from the widget's shadow,
+ * and compare the two. Both include the widget's sparkline, pushed with it.
+ *
+ * After the run the screen is redrawn whole and checked to be the same, so that a
+ * shadow out of step with the panel shows up as a failure rather than fewer bytes */
+
+#include <vector>
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define BENCH_START     1704067200      // 2024-01-01
+#define BENCH_UPDATES   2000
+#define BENCH_STEP      60              // Seconds between readings
+
+int main() {
+
+    touchEvents = xQueueCreate(TOUCH_QUEUE_LEN, sizeof(TouchEvent));
+    dispBegin();
+
+    /* A day between 19 and 23 °C first, so the high and low stay put while the
+     * reading wanders between 20 and 22 °C */
+    time_t t = BENCH_START;
+    for (int i = 0; i < 24*60; i++, t += BENCH_STEP) {
+        data.indoor.temperature.setValue(i % 2 ? 19.0 : 23.0, t);
+    }
+    dispUpdate();
+
+    float value = 21.0;
+    uint32_t panelBytes = 0, countedBytes = 0, widgetPushes = 0;
+    for (int i = 0; i < BENCH_UPDATES; i++, t += BENCH_STEP) {
+        value += testRandom() % 2 ? 0.1 : -0.1;
+        if (value > 22.0 || value < 20.0) { value = 21.0; }
+        data.indoor.temperature.setValue(value, t);
+        uint32_t panel = hostPanel.bytes, counted = dispStats.bytesPushed, unchanged = dispStats.unchanged;
+        dispUpdate();
+        panelBytes += hostPanel.bytes - panel;
+        countedBytes += dispStats.bytesPushed - counted;
+        widgetPushes += dispStats.unchanged == unchanged;
+    }
+    printf("%s, %u updates with %u widget pushes\n", DISP_DIFF ? "Pushing differences" : "Pushing whole widgets",
+           BENCH_UPDATES, widgetPushes);
+    printf("  %8.0f bytes per update over SPI, %.0f counted by the display code\n",
+           (double)panelBytes / BENCH_UPDATES, (double)countedBytes / BENCH_UPDATES);
+    printf("  %8u bytes for a whole widget, %u for its sparkline\n", DISP_WINDOW_BYTES + 2 * 160 * 60,
+           DISP_WINDOW_BYTES + 2 * GRAPH_WIDTH * GRAPH_HEIGHT);
+    CHECK(panelBytes == countedBytes, "display code counted %u bytes, panel %u", countedBytes, panelBytes);
+
+    std::vector<uint16_t> shown(&hostPanel.pixels[0][0], &hostPanel.pixels[0][0] + TFT_WIDTH * TFT_HEIGHT);
+    dispHome();
+    dispUpdate();
+    CHECK(!memcmp(shown.data(), hostPanel.pixels, sizeof(hostPanel.pixels)), "screen differs from a whole redraw");
+    return testResult();
+}
@@ -0,0 +1,74 @@
+/* Time to render one value widget into its 16-bpp sprite, through the glyph cache as
+ * dispValueWidget() does and through drawFloat() as it did before, which blends every
+ * pixel of every glyph as it is drawn. Both render the same values and are checked to
+ * give the same pixels. The smooth font drawing is the stand-in's, which blends and
+ * plots pixel by pixel as the library does, so the ratio is the figure to go by */
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define BENCH_WIDGETS   20000
+
+/* Widget as rendered before the glyph cache */
+static void benchDrawFloatWidget(TFT_eSprite *spr, const char *label, float value, float maximum, float minimum, uint8_t dp) {
+
+    spr->fillSprite(TFT_BLACK);
+    spr->setTextDatum(MC_DATUM);
+
+    fontCache.select(spr, FONT_36);
+    spr->setTextColor(TFT_GREEN, TFT_BLACK);
+    spr->drawFloat(value, dp, 50, 40);
+
+    fontCache.select(spr, FONT_12);
+    spr->setTextColor(0x03E0, TFT_BLACK);
+    spr->drawString(label, 50, 10);
+
+    fontCache.select(spr, FONT_24);
+    spr->setTextColor(TFT_MAROON, TFT_BLACK);
+    spr->drawFloat(maximum, dp, 130, 15);
+    spr->setTextColor(TFT_NAVY, TFT_BLACK);
+    spr->drawFloat(minimum, dp, 130, 45);
+    fontCache.release(spr);
+}
+
+static void benchGlyphWidget(TFT_eSprite *spr, const char *label, float value, float maximum, float minimum, uint8_t dp) {
+
+    WidgetText text;
+    formatFloat(text.value, sizeof(text.value), value, dp);
+    formatFloat(text.maximum, sizeof(text.maximum), maximum, dp);
+    formatFloat(text.minimum, sizeof(text.minimum), minimum, dp);
+    dispValueWidget(spr, label, text);
+}
+
+static float benchValue(int i) { return 18.0 + (i % 800) * 0.01; }
+
+int main() {
+
+    TFT_eSprite glyphs(&tft), floats(&tft);
+    glyphs.createSprite(160, 60);
+    floats.createSprite(160, 60);
+    fontCache.begin(&glyphs);
+
+    int differ = 0;
+    for (int i = 0; i < 800; i++) {
+        benchGlyphWidget(&glyphs, "Temperature", benchValue(i), benchValue(i + 300), benchValue(i + 500), 2);
+        benchDrawFloatWidget(&floats, "Temperature", benchValue(i), benchValue(i + 300), benchValue(i + 500), 2);
+        if (memcmp(glyphs.getPointer(), floats.getPointer(), dispSpriteBytes(&glyphs))) { differ++; }
+    }
+    CHECK(!differ, "%d of 800 widgets rendered differently", differ);
+
+    uint64_t begin = benchNanos();
+    for (int i = 0; i < BENCH_WIDGETS; i++) {
+        benchDrawFloatWidget(&floats, "Temperature", benchValue(i), benchValue(i + 300), benchValue(i + 500), 2);
+    }
+    double drawFloat = (double)(benchNanos() - begin) / BENCH_WIDGETS;
+    begin = benchNanos();
+    for (int i = 0; i < BENCH_WIDGETS; i++) {
+        benchGlyphWidget(&glyphs, "Temperature", benchValue(i), benchValue(i + 300), benchValue(i + 500), 2);
+    }
+    double glyph = (double)(benchNanos() - begin) / BENCH_WIDGETS;
+    printf("Path          us/widget\n");
+    printf("drawFloat()  %10.2f\n", drawFloat / 1000);
+    printf("Glyph cache  %10.2f  (%.1fx)\n", glyph / 1000, drawFloat / glyph);
+    return testResult();
+}
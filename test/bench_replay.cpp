@@ -0,0 +1,77 @@
+/* Time to replay the history log at startup, with 30 hours of the six records logged a
+ * minute at a time as the firmware does, so that the files also hold minutes from before
+ * the 24 hours shown. Each record's high and low after the replay are checked against
+ * the minutes logged in the last 24 hours, and its value against the newest.
+ *
+ * Runs in a directory of its own under /tmp, so the flash directory of the host build is
+ * left alone. The host reads files far faster than the flash, so the time is the cost of
+ * the records taking the minutes rather than of reading them */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define BENCH_HOURS     30
+
+int main() {
+
+    char dir[] = "/tmp/bench-replay-XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir)) {
+        printf("cannot make a directory to run in\n");
+        return 1;
+    }
+    dispTaskHandle = xTaskGetCurrentTaskHandle();       // Notified when the replay is done
+    LittleFS.begin(true);
+    logState.ready = true;
+
+    /* Each record wanders through its own range, a minute at a time */
+    int32_t now = time(nullptr) / 60, first = now - BENCH_HOURS * 60;
+    int16_t lows[LOG_RECORDS], highs[LOG_RECORDS], values[LOG_RECORDS];
+    for (uint8_t id = 0; id < LOG_RECORDS; id++) {
+        lows[id] = INT16_MAX;
+        highs[id] = INT16_MIN;
+    }
+    for (int32_t minute = first; minute < now; minute++) {
+        for (uint8_t id = 0; id < LOG_RECORDS; id++) {
+            int16_t value = 1000 * id + testRandom() % 500, spread = testRandom() % 20;
+            logState.minutes[id].add(minute, value - spread, value + spread, 1);
+            logState.last[id] = value;
+            logMinute(id);
+            if (minute >= now - DATA_MINUTES) {
+                lows[id] = std::min<int16_t>(lows[id], value - spread);
+                highs[id] = std::max<int16_t>(highs[id], value + spread);
+            }
+            values[id] = value;
+        }
+        if (minute % 10 == 0) { logFlush(); }
+    }
+    logFlush();
+    logState = {};
+
+    uint64_t start = benchNanos();
+    logReplay();
+    uint64_t nanos = benchNanos() - start;
+    printf("Replayed %d hours of %u records in %.1f ms\n", BENCH_HOURS, (unsigned)LOG_RECORDS, nanos / 1e6);
+
+    for (uint8_t id = 0; id < LOG_RECORDS; id++) {
+        DataRecord *record = logRecords[id];
+        DataSnapshot snapshot = record->getSnapshot();
+        CHECK(record->encode(snapshot.minimum) == lows[id], "record %u low %d, logged %d", id,
+              record->encode(snapshot.minimum), lows[id]);
+        CHECK(record->encode(snapshot.maximum) == highs[id], "record %u high %d, logged %d", id,
+              record->encode(snapshot.maximum), highs[id]);
+        CHECK(record->encode(snapshot.value) == values[id], "record %u value %d, logged %d", id,
+              record->encode(snapshot.value), values[id]);
+    }
+    char path[20];
+    for (uint8_t i = 0; i < LOG_FILES; i++) {
+        logPath(path, sizeof(path), i);
+        LittleFS.remove(path);
+    }
+    chdir("/");
+    rmdir((std::string(dir) + "/" HOST_FLASH_DIR).c_str());
+    rmdir(dir);
+    return testResult();
+}
@@ -0,0 +1,45 @@
+/* Shared by the host tests and benchmarks in this directory. Each is a program that
+ * includes the firmware source, to reach its internals, and links the stand-ins in
+ * ../host built with HOST_NO_MAIN */
+
+#pragma once
+
+#include <chrono>
+#include <stdio.h>
+
+static int testFailures = 0;
+
+/* Report a failed check and carry on, so that one run shows every failure */
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        testFailures++; \
+        printf("%s:%d: FAIL ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while (0)
+
+/* Exit status for a test program, after summarising its checks */
+static inline int testResult() {
+
+    if (testFailures) { printf("%d checks failed\n", testFailures); }
+    else { printf("All checks passed\n"); }
+    return testFailures ? 1 : 0;
+}
+
+/* Nanoseconds on a monotonic clock, for timing benchmarks */
+static inline uint64_t benchNanos() {
+
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+/* Deterministic pseudo-random numbers, so that every run sees the same streams */
+static inline uint32_t testRandom() {
+
+    static uint32_t state = 2463534242;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
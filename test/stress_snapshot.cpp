@@ -0,0 +1,80 @@
+/* Concurrency stress test of a DataRecord's published state, built with ThreadSanitizer:
+ * one writer adds samples as the MQTT task does while readers take snapshots and graph
+ * columns as the display task does. Each sample's value is a function of its time, so a
+ * snapshot mixing two publishes shows up as a value that does not match its timestamp,
+ * and a graph column read as another's, such as the oldest read from the slot the newest
+ * has just taken over, as a range that its samples could not have had */
+
+#include <thread>
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define STRESS_SAMPLES  400000
+#define STRESS_READERS  3
+
+/* Hundredths in the fixed point the record keeps */
+static int16_t stressValue(uint32_t t) { return t % 1000; }
+
+/* Range of the values of a column's samples, from the first sample on */
+static void stressRange(uint32_t column, uint32_t first, int16_t &low, int16_t &high) {
+
+    uint32_t from = std::max(column * DATA_COLUMN_MINUTES * 60, first);
+    uint32_t to = (column + 1) * DATA_COLUMN_MINUTES * 60 - 1;
+    low = stressValue(from);
+    high = stressValue(to);
+    if (low > high) {
+        low = 0;
+        high = 999;
+    }
+}
+
+int main() {
+
+    DataRecord *record = new DataRecord(0.01);
+    time_t start = time(nullptr) - STRESS_SAMPLES;
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0}, ranges{0}, columns{0};
+    std::atomic<uint32_t> reads{0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < STRESS_READERS; r++) {
+        readers.emplace_back([&]() {
+            uint32_t count = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                DataSnapshot snapshot = record->getSnapshot();
+                count++;
+                if (!snapshot.timestamp) { continue; }
+                if (record->encode(snapshot.value) != stressValue(snapshot.timestamp)) { torn++; }
+                if (snapshot.minimum > snapshot.value || snapshot.maximum < snapshot.value) { ranges++; }
+                if (snapshot.column != snapshot.timestamp / 60 / DATA_COLUMN_MINUTES) { torn++; }
+                float low, high;
+                if (record->getColumn(snapshot.column, low, high) && (low > high || low < 0 || high > 9.99)) { columns++; }
+                /* The oldest column is complete, so its range is known */
+                uint32_t oldest = snapshot.column - DATA_COLUMNS + 1;
+                int16_t lo, hi;
+                stressRange(oldest, start, lo, hi);
+                for (int i = 0; i < 16; i++) {
+                    if (record->getColumn(oldest, low, high) && (record->encode(low) != lo || record->encode(high) != hi)) {
+                        columns++;
+                    }
+                }
+            }
+            reads += count;
+        });
+    }
+
+    for (uint32_t i = 0; i < STRESS_SAMPLES; i++) {
+        uint32_t t = start + i;
+        record->setValue(record->decode(stressValue(t)), t);
+    }
+    done = true;
+    for (auto &reader : readers) { reader.join(); }
+
+    printf("%u samples written, %u snapshots read\n", STRESS_SAMPLES, reads.load());
+    CHECK(!torn, "%d snapshots mixed two samples", torn.load());
+    CHECK(!ranges, "%d snapshots had the value outside the high and low", ranges.load());
+    CHECK(!columns, "%d graph columns read with a range not their own", columns.load());
+    delete record;
+    return testResult();
+}
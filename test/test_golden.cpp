@@ -0,0 +1,106 @@
+/* Golden image test of the home screen: six widgets with a day of history behind their
+ * sparklines, rendered through the display code and saved by the stand-in panel, must
+ * match test/golden/home-16bpp.ppm, or home-4bpp.ppm built with DISP_SPRITE_4BPP=1. The
+ * 4-bpp screen is also compared with the 16-bpp golden one: it only rounds the
+ * anti-aliasing of the text to its palette's shades, so it may differ only at the text's
+ * anti-aliased edges, not where the screen is black or a text colour at full strength,
+ * and only by part of a shade.
+ *
+ * Run from the project directory. Pass --update to write the golden image afresh after
+ * a deliberate change to the screen, and check the result by eye. On a mismatch the
+ * screen is saved beside the golden one as .actual.ppm */
+
+#include <string>
+#include <vector>
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define GOLDEN_DIR      "test/golden/"
+#define GOLDEN_16BPP    GOLDEN_DIR "home-16bpp.ppm"
+#define GOLDEN_START    1704067200      // 2024-01-01, so the columns are always the same
+#define GOLDEN_SHADE    40              // Most a 4-bpp channel may be off, out of 255
+
+#if DISP_SPRITE_4BPP
+#define GOLDEN_PATH     GOLDEN_DIR "home-4bpp.ppm"
+#else
+#define GOLDEN_PATH     GOLDEN_16BPP
+#endif
+
+static std::vector<uint8_t> goldenRead(const char *path) {
+
+    std::vector<uint8_t> image;
+    FILE *file = fopen(path, "rb");
+    if (!file) { return image; }
+    for (int c; (c = fgetc(file)) != EOF; ) { image.push_back(c); }
+    fclose(file);
+    return image;
+}
+
+/* A day of samples every five minutes, each record on a daily cycle of its own */
+static void goldenData() {
+
+    DataSet *sets[] = { &data.indoor, &data.outdoor };
+    for (uint32_t t = 0; t <= 24*60*60; t += 300) {
+        for (int s = 0; s < 2; s++) {
+            float phase = t * 2 * M_PI / (24*60*60) + s;
+            sets[s]->temperature.setValue(s ? 8.0 + 6.0 * sinf(phase) : 21.0 + 1.5 * sinf(phase), GOLDEN_START + t);
+            sets[s]->humidity.setValue(s ? 80.0 - 15.0 * sinf(phase) : 45.0 + 5.0 * cosf(phase), GOLDEN_START + t);
+            sets[s]->pressure.setValue(1013.0 + 4.0 * sinf(phase / 2), GOLDEN_START + t);
+        }
+    }
+}
+
+#if DISP_SPRITE_4BPP
+
+/* Whether a pixel of a PPM is the given colour, expanded as HostPanel::writePPM() does */
+static bool goldenIs(const uint8_t *rgb, uint16_t c) {
+
+    return rgb[0] == ((c >> 8 & 0xF8) | c >> 13) && rgb[1] == ((c >> 3 & 0xFC) | (c >> 9 & 3)) &&
+           rgb[2] == ((c << 3 & 0xF8) | (c >> 2 & 7));
+}
+
+#endif
+
+int main(int argc, char **argv) {
+
+    touchEvents = xQueueCreate(TOUCH_QUEUE_LEN, sizeof(TouchEvent));
+    dispBegin();
+    goldenData();
+    dispUpdate();
+
+    std::string actualPath = std::string(GOLDEN_PATH).replace(strlen(GOLDEN_PATH) - 4, 4, ".actual.ppm");
+    if (argc > 1 && !strcmp(argv[1], "--update")) {
+        CHECK(hostPanel.writePPM(GOLDEN_PATH), "cannot write %s", GOLDEN_PATH);
+        printf("Wrote %s\n", GOLDEN_PATH);
+        return testResult();
+    }
+    CHECK(hostPanel.writePPM(actualPath.c_str()), "cannot write %s", actualPath.c_str());
+    std::vector<uint8_t> actual = goldenRead(actualPath.c_str()), golden = goldenRead(GOLDEN_PATH);
+    CHECK(golden.size(), "no golden image %s, make it with --update", GOLDEN_PATH);
+    bool same = actual == golden;
+    CHECK(same || !golden.size(), "screen differs from %s, see %s", GOLDEN_PATH, actualPath.c_str());
+
+#if DISP_SPRITE_4BPP
+    /* Both images are 320x240 PPMs with the same header, so the bytes line up */
+    std::vector<uint8_t> reference = goldenRead(GOLDEN_16BPP);
+    CHECK(reference.size() == actual.size(), "no 16-bpp golden image %s to compare with", GOLDEN_16BPP);
+    if (reference.size() == actual.size()) {
+        size_t pixels = 0, changed = 0, solid = 0, worst = 0;
+        for (size_t i = actual.size() - 320 * 240 * 3; i < actual.size(); i += 3, pixels++) {
+            if (!memcmp(&actual[i], &reference[i], 3)) { continue; }
+            changed++;
+            for (int c = 0; c < 3; c++) { worst = std::max<size_t>(worst, abs(actual[i + c] - reference[i + c])); }
+            bool full = goldenIs(&reference[i], TFT_BLACK);
+            for (auto &ramp : paletteRamps) { full |= goldenIs(&reference[i], ramp.color); }
+            solid += full;
+        }
+        printf("4-bpp screen: %zu of %zu pixels differ from 16 bpp, by %zu at most\n", changed, pixels, worst);
+        CHECK(!solid, "%zu pixels differ that are black or a text colour at full strength", solid);
+        CHECK(worst <= GOLDEN_SHADE, "a pixel is off by %zu, more than part of a shade", worst);
+    }
+#endif
+
+    if (same) { remove(actualPath.c_str()); }
+    return testResult();
+}
@@ -0,0 +1,110 @@
+/* DataRecord's graph columns, and its 24-hour and 7-day highs and lows against a
+ * brute-force scan of every sample in the window over randomized streams: bursts of
+ * samples in the same second, steady publishing, pauses of minutes and outages of hours,
+ * with the values wandering and now and then spiking. The day's window is every sample
+ * whose minute is within DATA_MINUTES of the newest one's, and the week's every sample
+ * whose quarter hour is within DATA_QUARTERS of the newest one's. The week, being longer
+ * to scan, is checked every TEST_WEEK_EVERY samples */
+
+#include <deque>
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define TEST_STREAMS    16
+#define TEST_SAMPLES    50000
+#define TEST_WEEK_EVERY 16
+
+struct TestSample {
+    time_t time;
+    int16_t value;
+};
+
+/* Seconds to the next sample, mostly steady with the odd pause or outage */
+static uint32_t testInterval() {
+
+    uint32_t kind = testRandom() % 1000;
+    if (kind < 100) { return 0; }
+    if (kind < 970) { return 1 + testRandom() % 60; }
+    if (kind < 997) { return 60 + testRandom() % (30*60); }
+    return 60*60 + testRandom() % (30*60*60);
+}
+
+static void testStream(int stream) {
+
+    DataRecord *record = new DataRecord(0.01);
+    std::deque<TestSample> window, week;
+    time_t t = time(nullptr) - 365*24*60*60;
+    float value = 20.0;
+    int failures = testFailures;
+    for (int i = 0; i < TEST_SAMPLES && testFailures - failures < 10; i++) {
+        t += testInterval();
+        value += (int)(testRandom() % 21 - 10) * 0.01;
+        float sample = testRandom() % 500 ? value : value + (int)(testRandom() % 2001 - 1000) * 0.01;
+        record->setValue(sample, t);
+        window.push_back({t, record->encode(sample)});
+        while (window.front().time / 60 < t / 60 - DATA_MINUTES) { window.pop_front(); }
+        week.push_back(window.back());
+        while (week.front().time / (15*60) < t / (15*60) - DATA_QUARTERS) { week.pop_front(); }
+        int16_t low = INT16_MAX, high = INT16_MIN;
+        for (const TestSample &s : window) {
+            if (s.value < low) { low = s.value; }
+            if (s.value > high) { high = s.value; }
+        }
+        DataSnapshot snapshot = record->getSnapshot();
+        CHECK(record->getMinimum() == record->decode(low), "stream %d sample %d: minimum %.2f, scan %.2f", stream, i, record->getMinimum(), record->decode(low));
+        CHECK(record->getMaximum() == record->decode(high), "stream %d sample %d: maximum %.2f, scan %.2f", stream, i, record->getMaximum(), record->decode(high));
+        CHECK(snapshot.minimum == record->decode(low) && snapshot.maximum == record->decode(high), "stream %d sample %d: snapshot range differs", stream, i);
+        CHECK(snapshot.value == record->decode(window.back().value), "stream %d sample %d: value %.2f", stream, i, snapshot.value);
+        if (i % TEST_WEEK_EVERY) { continue; }
+        low = INT16_MAX, high = INT16_MIN;
+        for (const TestSample &s : week) {
+            if (s.value < low) { low = s.value; }
+            if (s.value > high) { high = s.value; }
+        }
+        CHECK(record->getWeekMinimum() == record->decode(low), "stream %d sample %d: week minimum %.2f, scan %.2f", stream, i, record->getWeekMinimum(), record->decode(low));
+        CHECK(record->getWeekMaximum() == record->decode(high), "stream %d sample %d: week maximum %.2f, scan %.2f", stream, i, record->getWeekMaximum(), record->decode(high));
+    }
+    delete record;
+}
+
+/* A graph column holds the range of its own samples. The slot the column after the newest
+ * will reuse still holds the one from 24 hours before, so it must read as empty */
+static void testColumns() {
+
+    DataRecord *record = new DataRecord(0.01);
+    time_t t = (time(nullptr) - 2*24*60*60) / 600 * 600;     // Start of an even column
+    uint32_t column = t / 60 / DATA_COLUMN_MINUTES;
+    record->setValue(9.0, t - (DATA_COLUMNS - 1) * DATA_COLUMN_MINUTES * 60);
+    record->setValue(5.0, t);
+    float low, high;
+    CHECK(record->getColumn(column, low, high) && low == 5.0 && high == 5.0, "newest column");
+    CHECK(record->getColumn(column - DATA_COLUMNS + 1, low, high) && high == 9.0, "oldest column");
+    CHECK(!record->getColumn(column + 1, low, high), "column after the newest read %.2f", high);
+    CHECK(!record->getColumn(column - DATA_COLUMNS, low, high), "column before the oldest read %.2f", high);
+    CHECK(!record->getColumn(column - 1, low, high), "column without samples read %.2f", high);
+    delete record;
+}
+
+/* A steady reading still changes the graph as it moves into a new column, so setValue()
+ * has to say so for the display to be told */
+static void testColumnChanges() {
+
+    DataRecord *record = new DataRecord(0.01);
+    time_t t = (time(nullptr) - 24*60*60) / 300 * 300;     // Start of a column
+    CHECK(record->setValue(20.0, t), "first sample unchanged");
+    CHECK(!record->setValue(20.0, t + 60), "same value in the same column changed");
+    CHECK(record->setValue(20.0, t + 600), "same value in a new column unchanged");
+    CHECK(record->setValue(20.0, t + 1200), "same value in a later column unchanged");
+    CHECK(record->setValue(20.01, t + 1260) && record->setValue(20.0, t + 1270), "value changed in the same column unchanged");
+    CHECK(!record->setValue(20.0, t + 1280), "value within the column's range changed");
+    delete record;
+}
+
+int main() {
+
+    testColumns();
+    testColumnChanges();
+    for (int stream = 0; stream < TEST_STREAMS; stream++) { testStream(stream); }
+    return testResult();
+}
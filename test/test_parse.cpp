@@ -0,0 +1,98 @@
+/* Fuzz harness for the MQTT payload parsers: each input is copied into a heap buffer of
+ * exactly its length, with no terminator, and handed to mqttParseValue() and to
+ * mqttHandleState(), so with AddressSanitizer any read at or past len is caught, and
+ * UndefinedBehaviorSanitizer catches overflows and out-of-range conversions. Numbers
+ * that parse are also checked against strtof().
+ *
+ * Run as a program it replays the corpus in the directory given, test/corpus by default,
+ * with every truncation and a few thousand mutations of each input. Built with
+ * TEST_LIBFUZZER and clang's -fsanitize=fuzzer it is a libFuzzer target instead */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/main.cpp"
+#include "host_test.h"
+
+#define TEST_MUTATIONS  2000        // Mutated copies of each corpus input
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *input, size_t size) {
+
+    uint8_t *payload = (uint8_t *)malloc(size ? size : 1);
+    if (size) { memcpy(payload, input, size); }
+
+    float value;
+    if (mqttParseValue(payload, size, &value)) {
+        std::string text((const char *)input, size);
+        float expected = strtof(text.c_str(), nullptr);
+        CHECK(fabsf(value - expected) <= fabsf(expected) * 2e-7 + 1e-38, "\"%s\" parsed as %g, strtof gives %g", text.c_str(), value, expected);
+    }
+    mqttHandleState(&data.indoor, payload, size);
+
+    free(payload);
+    return 0;
+}
+
+#ifndef TEST_LIBFUZZER
+
+/* Bytes the parsers treat specially, most mutations use one of them */
+static const char testAlphabet[] = "0123456789.-+eE{}[]\":, \t\\u";
+
+static std::vector<uint8_t> testMutate(std::vector<uint8_t> input) {
+
+    for (uint32_t edits = 1 + testRandom() % 3; edits; edits--) {
+        uint8_t c = testRandom() % 4 ? testAlphabet[testRandom() % (sizeof(testAlphabet) - 1)] : testRandom();
+        size_t at = input.size() ? testRandom() % input.size() : 0;
+        switch (testRandom() % 3) {
+            case 0: if (input.size()) { input[at] = c; } break;
+            case 1: input.insert(input.begin() + at, c); break;
+            case 2: if (input.size()) { input.erase(input.begin() + at); } break;
+        }
+    }
+    return input;
+}
+
+int main(int argc, char **argv) {
+
+    const char *path = argc > 1 ? argv[1] : "test/corpus";
+    DIR *dir = opendir(path);
+    if (!dir) { printf("cannot open %s\n", path); return 1; }
+    std::vector<std::vector<uint8_t>> corpus;
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') { continue; }
+        std::string name = std::string(path) + "/" + entry->d_name;
+        FILE *file = fopen(name.c_str(), "rb");
+        if (!file) { continue; }
+        std::vector<uint8_t> input;
+        for (int c; (c = fgetc(file)) != EOF; ) { input.push_back(c); }
+        fclose(file);
+        corpus.push_back(input);
+    }
+    closedir(dir);
+
+    /* The rejected state messages are logged, which would bury the report */
+    dispTaskHandle = xTaskGetCurrentTaskHandle();
+    fflush(stdout);
+    int console = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    size_t runs = 0;
+    for (const auto &input : corpus) {
+        for (size_t len = 0; len <= input.size(); len++, runs++) { LLVMFuzzerTestOneInput(input.data(), len); }
+        for (int i = 0; i < TEST_MUTATIONS; i++, runs++) {
+            std::vector<uint8_t> mutated = testMutate(input);
+            LLVMFuzzerTestOneInput(mutated.data(), mutated.size());
+        }
+    }
+    fflush(stdout);
+    dup2(console, STDOUT_FILENO);
+
+    printf("%zu corpus inputs, %zu runs\n", corpus.size(), runs);
+    CHECK(corpus.size(), "empty corpus");
+    return testResult();
+}
+
+#endif